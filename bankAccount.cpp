@@ -37,6 +37,8 @@ void bankAccount :: init()
 
   this->number = -1;
   this->balance = -1;
+  this->spin = 0;
+  this->sequence = 0;
 
   // Attribute for mutex
   bool mutexAttrStatus = pthread_mutexattr_init(&this->attr);
@@ -51,6 +53,14 @@ void bankAccount :: init()
     print_output("Mutex PTHREAD_PROCESS_SHARED Attribute init failed!");
     exit(1);
   }
+  // A worker that dies holding the mutex must not block the others forever;
+  // the next owner gets EOWNERDEAD and recovers the account instead
+  bool mutexRobustStatus = pthread_mutexattr_setrobust(&this->attr, \
+    PTHREAD_MUTEX_ROBUST);
+  if(mutexRobustStatus != 0){
+    print_output("Mutex PTHREAD_MUTEX_ROBUST Attribute init failed!");
+    exit(1);
+  }
   // Init mutex with specified attributes
   bool mutexStatus = pthread_mutex_init(&this->mutex, &this->attr);
   if(mutexStatus != 0){
@@ -71,43 +81,7 @@ void bankAccount :: destroy(){
   pthread_mutex_destroy(&this->mutex);
 }
 
-// locks the account access
-int64_t bankAccount :: lock(){
-  // lock mutex
-  return pthread_mutex_lock(&this->mutex);
-}
-
-// try to lock the account access; returns otherwise
-int64_t bankAccount :: trylock(){
-  // try to lock mutex
-  return pthread_mutex_trylock(&this->mutex);
-}
-
-// releases the account access to the account
-int64_t bankAccount :: unlock(){
-  // unlock mutex
-  return pthread_mutex_unlock(&this->mutex);
-}
-
-// retrieves account balance
-int64_t bankAccount :: getBalance(){
-  // get the current balance
-  return this->balance;
-}
-
-// retrieves account number
-int64_t bankAccount :: getAccountNumber(){
-  // get the current balance
-  return this->number;
-}
-
-// sets the balance of the acount
-void bankAccount :: setBalance(int64_t newBalance){
-  // update the balance
-  this->balance = newBalance;
-}
-
-// sets the balance of the acount
+// sets the account number
 void bankAccount :: setAccountNumber(int64_t accountNumber){
   // update the account number
   this->number = accountNumber;
@@ -15,13 +15,31 @@
 
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 
+// The pool reserves address space for this many accounts (or the count the
+// input declares, if larger; less, down to a chunk, if that can't be had)
+// and grows into it in chunks, from
+// POOL_CHUNK_ACCOUNTS up to POOL_MAX_CHUNK_ACCOUNTS as it gets bigger. It is
+// mapped before the workers are forked, so they see every account the parser
+// adds later without remapping anything.
+#define   POOL_RESERVE_ACCOUNTS     (1LL << 26)
+#define   POOL_CHUNK_ACCOUNTS       4096
+#define   POOL_MAX_CHUNK_ACCOUNTS   (1 << 20)
+
 // -- Typedefs --
 typedef class bankAccount bankAccount_t;
 typedef class bankAccountNode node_t;
 typedef class bankAccountNode* poolHandle_t;
 typedef class bankAccountPool bankAccountPool_t;
+typedef struct accountRecord accountRecord_t;
+
+// Account as read from the input, before it is added to the pool
+struct accountRecord {
+  int64_t number;
+  int64_t balance;
+};
 
 // -- Class --
 class bankAccount
@@ -31,6 +49,8 @@ private:
   int64_t balance;    // Balance
   pthread_mutexattr_t attr; // Attribute for mutex
   pthread_mutex_t mutex;    // Mutexcle to protect read/write access to the acc
+  int32_t spin;             // Spin lock word (alternative to the mutex)
+  int64_t sequence;         // transfers applied to it so far (--ordered)
   bool is_initialized = false;     // flag for init
 
 public:
@@ -39,10 +59,114 @@ public:
   int64_t lock();                                   // Lock the access to mutex
   int64_t trylock();                                // Lock the access to mutex
   int64_t unlock();                                 // releases the access to mutex
+  int64_t makeConsistent();                         // after lock() returned EOWNERDEAD
+  int64_t spinLock();                               // Lock the access with the spin lock
+  int64_t spinTrylock();                            // Lock the access with the spin lock
+  int64_t spinUnlock();                             // releases the spin lock
   int64_t getAccountNumber();                       // retrieves account number
   int64_t getBalance();                             // retrieves account balance
   void setBalance(int64_t newBalance);              // sets account balance
+  void addBalance(int64_t delta);                   // atomically adds to balance (no lock)
   void setAccountNumber(int64_t accountNumber);     // sets the account number
+  int64_t getSequence();                            // transfers applied so far (--ordered)
+  void setSequence(int64_t sequence);               // publishes the transfers applied
+};
+
+// -- Hot accessors (inline so the transfer loop needs no calls) --
+
+// locks the account access
+inline int64_t bankAccount :: lock(){
+  // lock mutex
+  return pthread_mutex_lock(&this->mutex);
+}
+
+// try to lock the account access; returns otherwise
+inline int64_t bankAccount :: trylock(){
+  // try to lock mutex
+  return pthread_mutex_trylock(&this->mutex);
+}
+
+// releases the account access to the account
+inline int64_t bankAccount :: unlock(){
+  // unlock mutex
+  return pthread_mutex_unlock(&this->mutex);
+}
+
+// marks the mutex usable again after lock()/trylock() returned EOWNERDEAD
+// (its previous owner died holding it; see crashRecovery)
+inline int64_t bankAccount :: makeConsistent(){
+  return pthread_mutex_consistent(&this->mutex);
+}
+
+// try to lock the account access with the spin lock; returns otherwise
+inline int64_t bankAccount :: spinTrylock(){
+  return __atomic_exchange_n(&this->spin, 1, __ATOMIC_ACQUIRE);
+}
+
+// locks the account access with the spin lock
+// (yields the cpu after a while; the holder may be descheduled)
+inline int64_t bankAccount :: spinLock(){
+  int64_t spins = 0;
+  while(this->spinTrylock() != 0){
+    while(__atomic_load_n(&this->spin, __ATOMIC_RELAXED) != 0){
+      if(++spins % 64 == 0){
+        sched_yield();
+      }
+    }
+  }
+  return 0;
+}
+
+// releases the spin lock
+inline int64_t bankAccount :: spinUnlock(){
+  __atomic_store_n(&this->spin, 0, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// retrieves account balance
+inline int64_t bankAccount :: getBalance(){
+  // get the current balance
+  return this->balance;
+}
+
+// retrieves account number
+inline int64_t bankAccount :: getAccountNumber(){
+  // get the current balance
+  return this->number;
+}
+
+// sets the balance of the acount
+inline void bankAccount :: setBalance(int64_t newBalance){
+  // update the balance
+  this->balance = newBalance;
+}
+
+// retrieves the number of transfers applied to the account (--ordered); the
+// balance they left is visible once it is read
+inline int64_t bankAccount :: getSequence(){
+  return __atomic_load_n(&this->sequence, __ATOMIC_ACQUIRE);
+}
+
+// sets the number of transfers applied to the account, after their balance
+inline void bankAccount :: setSequence(int64_t sequence){
+  __atomic_store_n(&this->sequence, sequence, __ATOMIC_RELEASE);
+}
+
+// atomically adds delta to the balance of the account
+// (for merging without taking the account mutex)
+inline void bankAccount :: addBalance(int64_t delta){
+  __atomic_fetch_add(&this->balance, delta, __ATOMIC_RELAXED);
+}
+
+
+// This one is a struct for a bankAccount which will reside in
+// a bank account pool (which is an AVL Tree)
+struct bankAccountNode
+{
+  int height;
+  bankAccount_t account;
+  node_t* left;
+  node_t* right;
 };
 
 
@@ -54,16 +178,33 @@ private:
   void *poolMemory;
   size_t poolSize;
   int64_t totalAccounts;
+  pthread_mutex_t recoveryMutex;            // serializes crash recovery
 
 public:
-  void initPool(int64_t NumberOfAccounts);                    // Initialized the pool
+  void initPool(int64_t NumberOfAccounts = 0, bool hugePages = false, \
+    const char *segmentName = NULL);                          // Initialized the pool (0: count unknown)
   void deInitPool();                                          // Destroy the pool
   poolHandle_t getPoolHandle();                               // get the handle to the pool
+  void* getPoolMemory();                                      // base of the pool memory
   int64_t getTotalAccounts();                                 // Total accounts in the pool
+  void lockRecovery();                                        // enter crash recovery
+  void unlockRecovery();                                      // leave crash recovery
   bankAccount_t* at(int64_t accountNumber);                   // retrieve bank account
-  void addAccount(int64_t accountNumber, int64_t balance);    // Add new account to pool
+  inline bankAccount_t* atSlot(int64_t slot);                 // retrieve bank account by slot
+  int64_t slotOf(int64_t accountNumber);                      // slot of an account, -1 if unknown
+  int64_t addAccount(int64_t accountNumber, int64_t balance); // Add new account to pool
+  void bulkLoadAccounts(const accountRecord_t *records, \
+    int64_t count, int64_t *slots);                           // Add many accounts at once
   void dbgPrintAccountPool();                                 // prints all the contents of account pool
 };
 
 
+// retrieves the account stored at a slot of the pool memory
+// (slots are handed out by addAccount(); no lookup is done here)
+inline bankAccount_t* bankAccountPool :: atSlot(int64_t slot)
+{
+  return &((node_t*) this->poolMemory + slot)->account;
+}
+
+
 #endif
@@ -12,8 +12,12 @@
 
 #include "bankAccount.hpp"
 #include "debugMacros.hpp"
+#include "sharedMemory.hpp"
+#include <vector>
+#include <algorithm>
 #include <stdbool.h>
 #include <assert.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -25,22 +29,16 @@ using namespace std;
 // This will hold the address of the next available memory block for adding
 // bank account to the pool
 static node_t* sPoolBlock = NULL;
-// flag to hold the NumberOfAccounts in the pool
+// flag to hold the NumberOfAccounts the pool has room for (committed)
 static int64_t sPoolSpace = 0;
+// Accounts reserved beyond those (the pool grows into them)
+static int64_t sPoolReserve = 0;
+// Accounts committed so far (the next chunk is as big, within limits)
+static int64_t sPoolCommitted = 0;
 // flag to mark that we are initalized
 static bool is_initialized = false;
 
 
-// This one is a struct for a bankAccount which will reside in
-// a bank account pool (which is an AVL Tree)
-struct bankAccountNode
-{
-  int height;
-  bankAccount_t account;
-  node_t* left;
-  node_t* right;
-};
-
 // -- Initialize the account pool
 static void initPoolSpace(void *blockAddr, int64_t NumberOfAccounts)
 {
@@ -49,17 +47,35 @@ static void initPoolSpace(void *blockAddr, int64_t NumberOfAccounts)
     is_initialized = true;
     // Set the sPoolBlock address to point to memory mapped by main()
     sPoolBlock = (node_t*) blockAddr;
-    sPoolSpace = NumberOfAccounts;
+    sPoolSpace = 0;
+    sPoolReserve = NumberOfAccounts;
+    sPoolCommitted = 0;
     node_t *lastAddr = sPoolBlock + NumberOfAccounts;
 
     dbg_trace("Account Pool Initialized at Addr: " << sPoolBlock << " , " \
-              "Total Accounts: " << NumberOfAccounts << " , " \
+              "Reserved Accounts: " << NumberOfAccounts << " , " \
               "Total Size: " << (float) (sizeof(node_t)*NumberOfAccounts) << " , " \
               "Each Account Size: " << sizeof(node_t) << " , " \
               "End Addr: " << lastAddr  );
   }
 }
 
+// -- Commit the next chunk of the reserved pool memory
+static bool growPoolSpace()
+{
+  int64_t chunk = std::min<int64_t>(std::max<int64_t>(sPoolCommitted, POOL_CHUNK_ACCOUNTS), \
+    POOL_MAX_CHUNK_ACCOUNTS);
+  chunk = std::min(chunk, sPoolReserve);
+  if(chunk == 0 || commitSharedMemory(sPoolBlock + sPoolSpace, chunk * sizeof(node_t)) == false){
+    return false;
+  }
+  sPoolSpace += chunk;
+  sPoolReserve -= chunk;
+  sPoolCommitted += chunk;
+  dbg_trace("bankAccountPool grown to " << sPoolCommitted << " accounts");
+  return true;
+}
+
 // -- Create and return a new bankAccount node to be added to the accountPool
 static node_t* getNewNode(int64_t accountNumber, int64_t accountBalance)
 {
@@ -67,7 +83,7 @@ static node_t* getNewNode(int64_t accountNumber, int64_t accountBalance)
     dbg_trace("bankAccountPool is not Initialized yet!");
     return NULL;
   }
-  if(sPoolSpace == 0){
+  if(sPoolSpace == 0 && growPoolSpace() == false){
     dbg_trace("bankAccountPool is Full!");
     return NULL;
   }
@@ -84,9 +100,6 @@ static node_t* getNewNode(int64_t accountNumber, int64_t accountBalance)
   ++sPoolBlock;
   --sPoolSpace;
 
-  if(sPoolSpace == 0){
-    dbg_trace("bankAccountPool is now full. No more space!");
-  }
   return newNode;
 }
 
@@ -154,18 +167,19 @@ static int getBalance(node_t *N)
 
 // Recursive function to insert key in subtree rooted
 // with node and returns new root of subtree.
-static node_t* insert(node_t* node, int64_t key, int64_t value)
+// (*found is set to the node holding the key, new or existing)
+static node_t* insert(node_t* node, int64_t key, int64_t value, node_t **found)
 {
     /* 1.  Perform the normal BST insertion */
     if (node == NULL)
-        return(getNewNode(key, value));
+        return(*found = getNewNode(key, value));
 
     if (key < node->account.getAccountNumber())
-        node->left  = insert(node->left, key, value);
+        node->left  = insert(node->left, key, value, found);
     else if (key > node->account.getAccountNumber())
-        node->right = insert(node->right, key, value);
+        node->right = insert(node->right, key, value, found);
     else // Equal keys are not allowed in BST
-        return node;
+        return(*found = node);
 
     /* 2. Update height of this ancestor node */
     node->height = 1 + max(height(node->left),
@@ -207,6 +221,22 @@ static node_t* insert(node_t* node, int64_t key, int64_t value)
 
 
 
+// Builds a balanced tree over nodes[low, high) which are sorted by account
+// number and returns its root; every node is visited exactly once
+static node_t* buildBalanced(node_t *nodes, int64_t low, int64_t high)
+{
+  if(low >= high){
+    return NULL;
+  }
+  int64_t mid = low + (high - low) / 2;
+  node_t *root = &nodes[mid];
+  root->left = buildBalanced(nodes, low, mid);
+  root->right = buildBalanced(nodes, mid + 1, high);
+  root->height = 1 + max(height(root->left), height(root->right));
+  return root;
+}
+
+
 // retrieves the handle to the requested node
 static node_t* getNode(node_t *node, int64_t key)
 {
@@ -264,7 +294,8 @@ void printAccountPool(node_t *node)
 //   this->totalAccounts = 0;
 // }
 
-void bankAccountPool :: initPool(int64_t NumberOfAccounts)
+void bankAccountPool :: initPool(int64_t NumberOfAccounts, bool hugePages, \
+  const char *segmentName)
 {
   if( is_initialized == true ){
     return;
@@ -274,21 +305,39 @@ void bankAccountPool :: initPool(int64_t NumberOfAccounts)
   this->poolSize = 0;
   this->totalAccounts = 0;
 
-  // mmap or malloc the memory here;
-  // this will be shared among processess
-  // this->poolMemory = malloc(NumberOfAccounts * sizeof(node_t));
-  this->poolSize = NumberOfAccounts * sizeof(node_t);
-  this->poolMemory = mmap(NULL, this->poolSize, \
-        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-  if(this->poolMemory == MAP_FAILED){
+  // Reserve the address space here; it will be shared among processess and
+  // only backed as the accounts are added (with a segmentName, the pool is a
+  // named segment others can attach to). A strict overcommit policy may not
+  // let us reserve that much, so ask for less until it does, down to a
+  // single chunk: the declared count is only a hint, and the pool is full
+  // only once the accounts actually added don't fit.
+  int64_t reserveAccounts = std::max<int64_t>(NumberOfAccounts, POOL_RESERVE_ACCOUNTS);
+  while(1)
+  {
+    this->poolSize = reserveAccounts * sizeof(node_t);
+    this->poolMemory = reserveSharedMemory(&this->poolSize, hugePages, segmentName);
+    if(this->poolMemory != NULL || reserveAccounts / 2 < POOL_CHUNK_ACCOUNTS){
+      break;
+    }
+    reserveAccounts /= 2;
+  }
+  if(this->poolMemory == NULL){
     print_output("PPID: " << getppid() << " , " \
                  "PID: " << getpid() << " , " \
       "Failed to map the memory for bankAccountPool! Exiting!");
     exit(1);
   }
+  // Shared by the workers, and robust like the account mutexes
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&this->recoveryMutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+
   // Initialize the pool space now so our accountPool nodes will be allocated
   // memory from this space
-  initPoolSpace(poolMemory, NumberOfAccounts);
+  initPoolSpace(poolMemory, this->poolSize / sizeof(node_t));
 }
 
 void bankAccountPool :: deInitPool()
@@ -305,6 +354,17 @@ void bankAccountPool :: deInitPool()
                  "Failed to unmap the accountPool memory! Exiting!");
     exit(1);
   }
+  pthread_mutex_destroy(&this->recoveryMutex);
+  // reset the pool space so that the pool can be initialized again
+  sPoolBlock = NULL;
+  sPoolSpace = 0;
+  sPoolReserve = 0;
+  sPoolCommitted = 0;
+  is_initialized = false;
+  this->handle = NULL;
+  this->poolMemory = NULL;
+  this->poolSize = 0;
+  this->totalAccounts = 0;
 }
 
 // retrieves current handle to the bankAccountPool
@@ -314,20 +374,102 @@ poolHandle_t bankAccountPool :: getPoolHandle()
   return this->handle;
 }
 
+// retrieves the base of the pool memory (the node at slot 0)
+void* bankAccountPool :: getPoolMemory()
+{
+  return this->poolMemory;
+}
+
 // retrieves the current count of bank accounts in the pool
 int64_t bankAccountPool :: getTotalAccounts()
 {
   return this->totalAccounts;
 }
 
-// Inserts a new bank account to the pool
-void bankAccountPool :: addAccount(int64_t accountNumber, \
+// enters crash recovery (one process at a time); a process that died in it
+// left nothing half done that the next one won't redo
+void bankAccountPool :: lockRecovery()
+{
+  if(pthread_mutex_lock(&this->recoveryMutex) == EOWNERDEAD){
+    pthread_mutex_consistent(&this->recoveryMutex);
+  }
+}
+
+// leaves crash recovery
+void bankAccountPool :: unlockRecovery()
+{
+  pthread_mutex_unlock(&this->recoveryMutex);
+}
+
+// Inserts a new bank account to the pool and returns its slot
+// (for a duplicate account number, the slot of the existing account)
+int64_t bankAccountPool :: addAccount(int64_t accountNumber, \
   int64_t balance) {
+    node_t *node = NULL;
     // Keep the current handle updated with the root node
-    this->handle = insert(this->handle, accountNumber, balance);
+    this->handle = insert(this->handle, accountNumber, balance, &node);
     this->totalAccounts++;
+    if(node == NULL){
+      return -1;
+    }
+    return node - (node_t*) this->poolMemory;
   }
 
+// Adds all the accounts of the input at once: the records are sorted by
+// account number (skipped when they already are), laid out in that order in
+// the pool memory and indexed with a balanced tree built in one pass.
+// slots[i] receives the slot of records[i] (-1 if the pool is full); as with
+// addAccount(), the first record of a duplicate account number wins.
+void bankAccountPool :: bulkLoadAccounts(const accountRecord_t *records, \
+  int64_t count, int64_t *slots)
+{
+  // Merging into an existing tree is done one account at a time
+  if(this->handle != NULL){
+    for(int64_t i = 0; i < count; i++){
+      slots[i] = this->addAccount(records[i].number, records[i].balance);
+    }
+    return;
+  }
+
+  // Order in which the records go to the pool (stable, by account number)
+  std::vector<int64_t> order(count);
+  bool sorted = true;
+  for(int64_t i = 0; i < count; i++){
+    order[i] = i;
+    if(i > 0 && records[i].number < records[i-1].number){
+      sorted = false;
+    }
+  }
+  if(sorted == false){
+    std::stable_sort(order.begin(), order.end(), [records](int64_t a, int64_t b) {
+      return records[a].number < records[b].number;
+    });
+  }
+
+  node_t *first = sPoolBlock;
+  int64_t loaded = 0;
+  int64_t lastSlot = -1;
+  for(int64_t i = 0; i < count; i++)
+  {
+    const accountRecord_t &record = records[order[i]];
+    if(i > 0 && lastSlot != -1 && record.number == records[order[i-1]].number){
+      slots[order[i]] = lastSlot;
+      continue;
+    }
+    node_t *node = getNewNode(record.number, record.balance);
+    lastSlot = (node == NULL) ? -1 : (node - (node_t*) this->poolMemory);
+    slots[order[i]] = lastSlot;
+    if(node != NULL){
+      ++loaded;
+    }
+  }
+
+  this->handle = buildBalanced(first, 0, loaded);
+  this->totalAccounts += count;
+  dbg_trace("Bulk loaded " << loaded << " accounts (" << count << " records, " \
+    << (sorted ? "already sorted" : "sorted") << ")");
+}
+
 //  retrieves the handle to account requested
 bankAccount_t* bankAccountPool :: at(int64_t accountNumber)
 {
@@ -340,6 +482,16 @@ bankAccount_t* bankAccountPool :: at(int64_t accountNumber)
   return requestedAccount;
 }
 
+// retrieves the slot of the account requested (-1 if there's no such account)
+int64_t bankAccountPool :: slotOf(int64_t accountNumber)
+{
+  poolHandle_t requestedNode = getNode(this->handle, accountNumber);
+  if(requestedNode == NULL){
+    return -1;
+  }
+  return requestedNode - (node_t*) this->poolMemory;
+}
+
 #ifdef DEBUG_TEST
 // -- debug print --
 void bankAccountPool :: dbgPrintAccountPool()
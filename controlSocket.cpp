@@ -0,0 +1,174 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T17:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: controlSocket.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T17:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "debugMacros.hpp"
+#include "controlSocket.hpp"
+
+// Std namespace
+using namespace std;
+
+// Whether path is a socket file (false if it is anything else or missing)
+static bool isSocketFile(const char *path)
+{
+  struct stat info;
+  return lstat(path, &info) == 0 && S_ISSOCK(info.st_mode);
+}
+
+// Listens on a Unix domain socket
+int openControlSocket(const char *path, int backlog)
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(address.sun_path)){
+    print_error("Socket path too long: " << path);
+    return -1;
+  }
+  strcpy(address.sun_path, path);
+
+  // Only a stale socket is replaced: not a file that isn't one, nor the
+  // socket of a process still listening on it
+  struct stat info;
+  if(lstat(path, &info) == 0){
+    if(S_ISSOCK(info.st_mode) == false){
+      print_error("Refusing to listen on " << path << ": it exists and is not a socket");
+      return -1;
+    }
+    if(socketInUse(path)){
+      print_error("Refusing to listen on " << path << ": another process is listening on it");
+      return -1;
+    }
+    unlink(path);
+  }
+  int controlSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(controlSocket < 0){
+    return -1;
+  }
+  // (mode 0600: only our user can connect)
+  mode_t mask = umask(0177);
+  int bound = bind(controlSocket, (struct sockaddr *) &address, sizeof(address));
+  umask(mask);
+  if(bound != 0 || listen(controlSocket, backlog) != 0){
+    print_error("Failed to listen on " << path << ": " << strerror(errno));
+    close(controlSocket);
+    return -1;
+  }
+  return controlSocket;
+}
+
+// Whether a process listens on the socket at path
+bool socketInUse(const char *path)
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  bool live = (probe >= 0 && \
+    connect(probe, (struct sockaddr *) &address, sizeof(address)) == 0);
+  if(probe >= 0){
+    close(probe);
+  }
+  return live;
+}
+
+// Whether the process at the other end of the connection runs as our user
+bool peerIsOurUser(int connection)
+{
+  struct ucred peerUser;
+  socklen_t length = sizeof(peerUser);
+  return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peerUser, &length) == 0 && \
+    peerUser.uid == geteuid();
+}
+
+// Waits for a client and reads its command line
+int acceptCommand(int controlSocket, std::string &command)
+{
+  int client = -1;
+  do {
+    client = accept(controlSocket, NULL, NULL);
+  } while(client < 0 && errno == EINTR);
+  if(client < 0){
+    return -1;
+  }
+  // A command reads and writes files with our rights: our user's only
+  if(peerIsOurUser(client) == false){
+    print_error("Refused a command from a process of another user");
+    replyCommand(client, "error: permission denied");
+    return -1;
+  }
+  // (a client that connects and stays silent must not stall the daemon)
+  struct timeval timeout = { COMMAND_TIMEOUT_MS / 1000, (COMMAND_TIMEOUT_MS % 1000) * 1000 };
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  command.clear();
+  char buffer[256];
+  while(command.size() < MAX_COMMAND_LENGTH)
+  {
+    ssize_t bytes = read(client, buffer, sizeof(buffer));
+    if(bytes < 0 && errno == EINTR){
+      continue;
+    }
+    if(bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      replyCommand(client, "error: timed out waiting for the command");
+      return -1;
+    }
+    if(bytes <= 0){
+      break;
+    }
+    command.append(buffer, bytes);
+    if(command.find('\n') != std::string::npos){
+      break;
+    }
+  }
+  // Only the first line counts
+  size_t end = command.find_first_of("\r\n");
+  if(end != std::string::npos){
+    command.erase(end);
+  }
+  return client;
+}
+
+// Sends the reply line and closes the connection
+void replyCommand(int client, const std::string &reply)
+{
+  std::string line = reply + "\n";
+  size_t sent = 0;
+  while(sent < line.size()){
+    // (MSG_NOSIGNAL: a client that went away must not kill the daemon)
+    ssize_t bytes = send(client, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+    if(bytes < 0 && errno == EINTR){
+      continue;
+    }
+    if(bytes <= 0){
+      break;
+    }
+    sent += bytes;
+  }
+  close(client);
+}
+
+// Stops listening and removes the socket file
+void closeControlSocket(int controlSocket, const char *path)
+{
+  close(controlSocket);
+  if(isSocketFile(path)){
+    unlink(path);
+  }
+}
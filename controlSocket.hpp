@@ -0,0 +1,46 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T17:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: controlSocket.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T17:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __CONTROL_SOCKET__
+#define __CONTROL_SOCKET__
+
+
+#include <stdint.h>
+#include <string>
+
+// Longest command line accepted from a client
+#define   MAX_COMMAND_LENGTH    4096
+// How long a client has to send its command line
+#define   COMMAND_TIMEOUT_MS    5000
+
+// Unix domain socket the daemon mode takes its commands from. A client
+// connects, sends one command line and gets one reply line back.
+
+// Listens on path (a stale socket file is replaced; anything else there,
+// or a socket someone listens on, is left alone and fails), with room for
+// backlog pending connections; the socket file is mode 0600. Returns the
+// socket or -1
+int openControlSocket(const char *path, int backlog = 8);
+// Whether a process listens on the socket at path
+bool socketInUse(const char *path);
+// Whether the process at the other end of the connection runs as our user
+bool peerIsOurUser(int connection);
+// Waits for a client and reads its command line (without the newline);
+// returns the client connection, or -1 (a client of another user, or one
+// that doesn't send its line within COMMAND_TIMEOUT_MS, is dropped)
+int acceptCommand(int controlSocket, std::string &command);
+// Sends the reply line to the client and closes the connection
+void replyCommand(int client, const std::string &reply);
+// Stops listening and removes the socket file (if it still is one)
+void closeControlSocket(int controlSocket, const char *path);
+
+#endif
@@ -0,0 +1,169 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T20:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: crashRecovery.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T20:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <algorithm>
+#include <errno.h>
+
+#include "debugMacros.hpp"
+#include "crashRecovery.hpp"
+
+// Std namespace
+using namespace std;
+
+
+// Passes the turns of an ordered transfer (and its legs) on (--ordered)
+static void passTurns(bankAccountPool_t *pool, const inflightRecord_t *record)
+{
+  const EFTRequest_t &request = record->request;
+  if(request.fromSeq < 0){
+    return;
+  }
+  pool->atSlot(request.fromSlot)->setSequence(request.fromSeq + 1);
+  pool->atSlot(request.toSlot)->setSequence(request.toSeq + 1);
+  for(int64_t i = 0; i < request.legs; i++){
+    pool->atSlot(record->legs[i].toSlot)->setSequence(record->legs[i].toSeq + 1);
+  }
+}
+
+// Completes a transfer (with its legs) from the balances saved before it
+// started (the caller is in recovery; the owner of the accounts is dead)
+static void rollForward(bankAccountPool_t *pool, inflightRecord_t *record)
+{
+  const EFTRequest_t &request = record->request;
+  int64_t debit = request.transferAmount;
+  for(int64_t i = 0; i < request.legs; i++){
+    const EFTRequest_t &leg = record->legs[i];
+    pool->atSlot(leg.toSlot)->setBalance(record->legBalances[i] + leg.transferAmount);
+    debit += leg.transferAmount;
+  }
+  pool->atSlot(request.fromSlot)->setBalance(record->fromBalance - debit);
+  pool->atSlot(request.toSlot)->setBalance(record->toBalance + request.transferAmount);
+  passTurns(pool, record);
+  setInflightState(record, INFLIGHT_APPLIED);
+}
+
+// Whether the request of a record (or one of its legs) is on the account at slot
+static bool recordTouches(const inflightRecord_t *record, int64_t slot)
+{
+  if(record->request.fromSlot == slot || record->request.toSlot == slot){
+    return true;
+  }
+  for(int64_t i = 0; i < record->request.legs; i++){
+    if(record->legs[i].toSlot == slot){
+      return true;
+    }
+  }
+  return false;
+}
+
+// Finishes the transfers dead owners were applying on the account at slot
+void recoverAccount(processData_t *workers, int64_t NumberOfProcesses, int64_t slot)
+{
+  bankAccountPool_t *pool = workers[0].accountPool;
+  pool->lockRecovery();
+    // Only a dead worker can be applying a transfer on an account we hold;
+    // its other accounts are either still held by it or by someone waiting
+    // here, so no one else touches those balances meanwhile
+    for(int64_t i = 0; i < NumberOfProcesses; i++){
+      inflightRecord_t *record = &workers[i].inflight;
+      if(record->state == INFLIGHT_APPLYING && recordTouches(record, slot)){
+        dbg_trace("Rolling forward the transfer of worker " << i << " on slot " << slot);
+        rollForward(pool, record);
+      }
+    }
+    pool->atSlot(slot)->makeConsistent();
+  pool->unlockRecovery();
+}
+
+// Locks the account at slot, recovering it if its owner died
+void lockAccountRecovering(processData_t *workers, int64_t NumberOfProcesses, int64_t slot)
+{
+  bankAccountPool_t *pool = workers[0].accountPool;
+  if(pool->atSlot(slot)->lock() == EOWNERDEAD){
+    recoverAccount(workers, NumberOfProcesses, slot);
+  }
+}
+
+// Finishes the request of a dead worker and repairs its queue
+int64_t recoverWorker(processData_t *workers, int64_t NumberOfProcesses, int64_t worker)
+{
+  processData_t *workerData = &workers[worker];
+  inflightRecord_t *record = &workerData->inflight;
+  bankAccountPool_t *pool = workerData->accountPool;
+  int64_t outcome = RECOVERED_NOTHING;
+
+  // A request still in the queue is left to the next worker
+  int64_t queued = workerData->EFTRequests.recover(record);
+
+  // A transfer it was applying (unless a worker that locked one of its
+  // accounts has already finished it)
+  pool->lockRecovery();
+    if(record->state == INFLIGHT_APPLYING){
+      rollForward(pool, record);
+      outcome = RECOVERED_ROLLED_FORWARD;
+    }
+  pool->unlockRecovery();
+
+  // A request it popped but had not started to apply, that must wait for its
+  // turn (--ordered): the worker that takes over the queue applies it first,
+  // as the request before it on one of its accounts may be queued there
+  if(record->state == INFLIGHT_POPPED && record->request.fromSeq >= 0){
+    outcome = RECOVERED_HANDED_OVER;
+  }
+
+  // Any other request it popped but had not started to apply: apply it
+  // here, its accounts locked in the workers' order
+  if(record->state == INFLIGHT_POPPED && outcome != RECOVERED_HANDED_OVER){
+    const EFTRequest_t &request = record->request;
+    if(request.fromSlot != request.toSlot){
+      int64_t slots[MAX_TRANSFER_LEGS + 1];
+      int64_t accounts = 0;
+      slots[accounts++] = request.fromSlot;
+      slots[accounts++] = request.toSlot;
+      for(int64_t i = 0; i < request.legs; i++){
+        slots[accounts++] = record->legs[i].toSlot;
+      }
+      std::sort(slots, slots + accounts);
+      for(int64_t i = 0; i < accounts; i++){
+        lockAccountRecovering(workers, NumberOfProcesses, slots[i]);
+      }
+        bankAccount_t *from = pool->atSlot(request.fromSlot);
+        bankAccount_t *to = pool->atSlot(request.toSlot);
+        from->setBalance(from->getBalance() - request.transferAmount);
+        to->setBalance(to->getBalance() + request.transferAmount);
+        for(int64_t i = 0; i < request.legs; i++){
+          const EFTRequest_t &leg = record->legs[i];
+          from->setBalance(from->getBalance() - leg.transferAmount);
+          pool->atSlot(leg.toSlot)->setBalance(pool->atSlot(leg.toSlot)->getBalance() \
+            + leg.transferAmount);
+        }
+      for(int64_t i = accounts; i > 0; i--){
+        pool->atSlot(slots[i-1])->unlock();
+      }
+    }
+    setInflightState(record, INFLIGHT_APPLIED);
+    outcome = RECOVERED_APPLIED;
+  }
+
+  // Whatever it applied is in its counters; the rest is queued (or handed over)
+  workerData->dispatched = workerData->stats.transfers + queued + \
+    (outcome == RECOVERED_HANDED_OVER ? 1 : 0);
+  return outcome;
+}
+
+// Only the transfer worker on mutexes keeps in-flight records; a batch or a
+// reduction worker can't be recovered, nor can a spin lock
+bool crashTolerantEngine(const transfOptions_t &options)
+{
+  return options.lockPolicy == LOCK_MUTEX && options.batchSize <= 1 && \
+    options.reduce == false;
+}
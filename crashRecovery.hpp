@@ -0,0 +1,57 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T20:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: crashRecovery.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T20:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __CRASH_RECOVERY__
+#define __CRASH_RECOVERY__
+
+
+#include <stdint.h>
+
+#include "transfProg.hpp"
+
+// A worker that dies in the middle of a transfer leaves its accounts locked
+// and maybe one of them updated. The account mutexes are robust, so the next
+// process to lock one of them gets EOWNERDEAD instead of blocking forever,
+// and every worker keeps an in-flight record of its request (see
+// workerQueue.hpp) telling how far it got. Both are enough to finish the
+// transfer: a transfer that was being applied is rolled forward from the
+// balances saved before it started (which can be done any number of times),
+// and one that was only popped is applied by the parent, so every request
+// is still applied exactly once. With --ordered, a popped request is left to
+// the worker that takes over the queue instead (the parent can't wait for
+// its turn), and the turns of a rolled forward transfer are passed on.
+// (processData_t of the workers are one array; recovery is serialized on
+// the recovery mutex of the account pool)
+
+// What recoverWorker() did with the request of a dead worker
+enum recoveryOutcome {
+  RECOVERED_NOTHING = 0,                    // nothing was in flight
+  RECOVERED_ROLLED_FORWARD = 1,             // the half applied transfer was completed
+  RECOVERED_APPLIED = 2,                    // the popped request was applied
+  RECOVERED_HANDED_OVER = 3                 // the popped request is left to the new worker
+};
+
+// The caller got EOWNERDEAD locking the account at slot: finishes the
+// transfers the dead owner was applying on it and makes its mutex usable
+void recoverAccount(processData_t *workers, int64_t NumberOfProcesses, int64_t slot);
+
+// Locks the account at slot, recovering it if its owner died
+void lockAccountRecovering(processData_t *workers, int64_t NumberOfProcesses, int64_t slot);
+
+// Finishes the request the (dead) worker had in flight and repairs its queue,
+// so a new worker can take over the queue; returns a recoveryOutcome
+int64_t recoverWorker(processData_t *workers, int64_t NumberOfProcesses, int64_t worker);
+
+// Whether the engine picked by the options can recover from a worker crash
+bool crashTolerantEngine(const transfOptions_t &options);
+
+#endif
@@ -36,4 +36,8 @@
         do { std::cout << message << std::endl; \
         } while(0)
 
+#define print_error( message ) \
+        do { std::cerr << message << std::endl; \
+        } while(0)
+
 #endif
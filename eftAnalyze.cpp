@@ -0,0 +1,444 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T21:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: eftAnalyze.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T21:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <stdlib.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "debugMacros.hpp"
+#include "transfProg.hpp"
+#include "inputReader.hpp"
+#include "lineParser.hpp"
+#include "transferCoalescer.hpp"
+#include "workloadStats.hpp"
+
+
+// Std namespace
+using namespace std;
+
+// Transfers the conflict rates are estimated on (from the head of the input)
+#define   CONFLICT_SAMPLE_TRANSFERS   (256 * 1024)
+// Coalescing windows tried
+#define   COALESCE_WINDOWS            { 256, 1024, 4096, 16384 }
+// Coalescing worth recommending: at least this many transfers per request
+#define   COALESCE_MIN_RATIO          1.5
+// --reduce keeps a delta per account in every worker; recommended up to
+#define   REDUCE_MAX_ACCOUNTS         (4 * 1024 * 1024)
+
+// Analyzer settings
+typedef struct analyzeOptions {
+  int64_t workers;                // worker count to report the conflict rate for
+  int64_t top;                    // hot accounts and pairs listed
+} analyzeOptions_t;
+
+// What the pre-pass found. Accounts are numbered densely (in the order they
+// are listed) and transfers refer to them by that index.
+typedef struct workload {
+  int64_t declaredAccounts;       // first line of the input (0: no count)
+  std::vector<int64_t> accounts;  // account numbers, by index
+  int64_t duplicateAccounts;      // listed more than once (the first one counts)
+  int64_t opened;                 // opened among the transfers (Open records)
+  std::vector<transferPair_t> transfers;  // by account index
+  int64_t rejected;               // transfers with unknown accounts
+  int64_t selfTransfers;          // from and to the same account
+  int64_t urgent;                 // transfers with a priority above 0
+  int64_t multiLeg;               // multi-leg transfers (their credits are in transfers)
+  int64_t inputBytes;             // size of the input (-1: not a regular file)
+} workload_t;
+
+
+// -- reads the input the way transfProg does, without applying anything
+static bool scanInput(const char *fileName, workload_t &load)
+{
+  inputReader_t reader;
+  if(reader.open(fileName) == FAIL){
+    print_error("eftAnalyze: failed to open " << fileName);
+    return false;
+  }
+  std::unordered_map<int64_t, int64_t> index;
+  const char *line = NULL;
+  size_t length = 0;
+  bool firstLine = true, transfersStarted = false;
+  while(reader.getLine(&line, &length))
+  {
+    // (the count on the first line is optional)
+    if(firstLine == true){
+      firstLine = false;
+      int64_t fields[2] = { 0, 0 };
+      if(parseLineFields(line, length, false, fields, 2) == 1){
+        load.declaredAccounts = std::max<int64_t>(fields[0], 0);
+        continue;
+      }
+    }
+    if(line[0] == 'T' || line[0] == 'S'){
+      transfersStarted = true;
+    }
+    if(transfersStarted == false || line[0] == 'O')
+    {
+      // "<account> <balance>" or "Open <account> <balance>"
+      int64_t fields[2] = { -1, 0 };
+      parseLineFields(line, length, line[0] == 'O', fields, 2);
+      if(fields[0] == -1){
+        continue;
+      }
+      if(index.insert(std::make_pair(fields[0], (int64_t) load.accounts.size())).second){
+        load.accounts.push_back(fields[0]);
+        load.opened += transfersStarted;
+      }
+      else {
+        ++load.duplicateAccounts;
+      }
+      continue;
+    }
+    // A multi-leg transfer counts as a transfer per credit
+    if(line[0] == 'S'){
+      int64_t fields[2 * MAX_TRANSFER_LEGS + 3];
+      int64_t parsed = parseLineFields(line, length, true, fields, 2 * MAX_TRANSFER_LEGS + 3);
+      int64_t credits = (parsed - 1) / 2;
+      std::unordered_map<int64_t, int64_t>::iterator from = index.find(fields[0]);
+      bool known = (parsed >= 3 && credits <= MAX_TRANSFER_LEGS && from != index.end());
+      for(int64_t i = 0; known && i < credits; i++){
+        known = (index.find(fields[1 + 2 * i]) != index.end());
+      }
+      if(known == false){
+        load.rejected += (parsed >= 3);
+        continue;
+      }
+      for(int64_t i = 0; i < credits; i++){
+        int64_t to = index[fields[1 + 2 * i]];
+        transferPair_t transfer = { from->second, to, fields[2 + 2 * i] };
+        load.transfers.push_back(transfer);
+        load.selfTransfers += (from->second == to);
+      }
+      ++load.multiLeg;
+      continue;
+    }
+    int64_t fields[4] = { -1, -1, 0, 0 };
+    parseLineFields(line, length, true, fields, 4);
+    if(fields[0] == -1 || fields[1] == -1){
+      continue;
+    }
+    std::unordered_map<int64_t, int64_t>::iterator from = index.find(fields[0]);
+    std::unordered_map<int64_t, int64_t>::iterator to = index.find(fields[1]);
+    if(from == index.end() || to == index.end()){
+      ++load.rejected;
+      continue;
+    }
+    transferPair_t transfer = { from->second, to->second, fields[2] };
+    load.transfers.push_back(transfer);
+    load.selfTransfers += (from->second == to->second);
+    load.urgent += (fields[3] > 0);
+  }
+  reader.close();
+  if(firstLine == true){
+    print_error("eftAnalyze: " << fileName << " is empty");
+    return false;
+  }
+  struct stat fileInfo;
+  load.inputBytes = (stat(fileName, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode)) ? \
+    fileInfo.st_size : -1;
+  return true;
+}
+
+// -- value at a fraction of a sorted vector
+static int64_t percentile(const std::vector<int64_t> &sorted, double fraction)
+{
+  if(sorted.empty()){
+    return 0;
+  }
+  size_t at = std::min(sorted.size() - 1, (size_t) (fraction * sorted.size()));
+  return sorted[at];
+}
+
+static std::string percent(double fraction)
+{
+  std::stringstream text;
+  text << std::fixed << std::setprecision(2) << 100 * fraction << "%";
+  return text.str();
+}
+
+// -- accounts: how many, how dense their numbers are
+static void reportAccounts(const workload_t &load)
+{
+  int64_t accounts = load.accounts.size();
+  print_output("Accounts: " << accounts << " listed (" << load.declaredAccounts \
+    << " declared, " << load.duplicateAccounts << " duplicate, " << load.opened \
+    << " opened among the transfers)");
+  if(accounts == 0){
+    return;
+  }
+  int64_t lowest = *std::min_element(load.accounts.begin(), load.accounts.end());
+  int64_t highest = *std::max_element(load.accounts.begin(), load.accounts.end());
+  print_output("  numbers " << lowest << " .. " << highest << ", density " \
+    << percent((double) accounts / ((double) highest - lowest + 1)));
+}
+
+// -- transfers per account: percentiles, a power-of-two histogram and the
+// busiest accounts
+static void reportDegrees(const workload_t &load, int64_t top)
+{
+  int64_t transfers = load.transfers.size();
+  print_output("Transfers: " << transfers << " (" << load.rejected << " rejected, " \
+    << load.selfTransfers << " to the same account, " << load.urgent << " urgent, " \
+    << load.multiLeg << " multi-leg transfer(s))");
+  if(transfers == 0){
+    return;
+  }
+  std::vector<int64_t> degree(load.accounts.size(), 0);
+  for(size_t i = 0; i < load.transfers.size(); i++){
+    ++degree[load.transfers[i].fromAccount];
+    if(load.transfers[i].toAccount != load.transfers[i].fromAccount){
+      ++degree[load.transfers[i].toAccount];
+    }
+  }
+  std::vector<int64_t> sorted(degree);
+  std::sort(sorted.begin(), sorted.end());
+  int64_t untouched = std::upper_bound(sorted.begin(), sorted.end(), 0) - sorted.begin();
+  print_output("Account degree (transfers per account): mean " << std::fixed \
+    << std::setprecision(1) << (double) (2 * transfers - load.selfTransfers) / degree.size() \
+    << ", p50 " << percentile(sorted, 0.50) << ", p90 " << percentile(sorted, 0.90) \
+    << ", p99 " << percentile(sorted, 0.99) << ", max " << sorted.back() \
+    << ", untouched " << untouched);
+
+  // accounts per power-of-two bucket of degree
+  std::vector<int64_t> buckets;
+  for(size_t i = untouched; i < sorted.size(); i++){
+    size_t bucket = 63 - __builtin_clzll(sorted[i]);
+    if(bucket >= buckets.size()){
+      buckets.resize(bucket + 1, 0);
+    }
+    ++buckets[bucket];
+  }
+  for(size_t bucket = 0; bucket < buckets.size(); bucket++){
+    if(buckets[bucket] == 0){
+      continue;
+    }
+    std::stringstream range;
+    range << (1LL << bucket) << "-" << (2LL << bucket) - 1;
+    print_output("  " << std::setw(11) << range.str() << " : " << buckets[bucket] \
+      << " account(s)");
+  }
+
+  std::vector<int64_t> order(degree.size());
+  for(size_t i = 0; i < order.size(); i++){
+    order[i] = i;
+  }
+  int64_t shown = std::min<int64_t>(top, order.size());
+  std::partial_sort(order.begin(), order.begin() + shown, order.end(), \
+    [&degree](int64_t a, int64_t b){ return degree[a] > degree[b]; });
+  for(int64_t i = 0; i < shown; i++){
+    print_output("  hot account " << load.accounts[order[i]] << ": " << degree[order[i]] \
+      << " transfer(s), " << percent((double) degree[order[i]] / transfers));
+  }
+}
+
+// -- how concentrated the transfers are on a few account pairs (either way)
+static void reportPairs(const workload_t &load, int64_t top)
+{
+  int64_t transfers = load.transfers.size();
+  if(transfers == 0){
+    return;
+  }
+  std::vector<uint64_t> keys(transfers);
+  for(int64_t i = 0; i < transfers; i++){
+    uint64_t low = std::min(load.transfers[i].fromAccount, load.transfers[i].toAccount);
+    uint64_t high = std::max(load.transfers[i].fromAccount, load.transfers[i].toAccount);
+    keys[i] = (low << 32) | high;
+  }
+  std::sort(keys.begin(), keys.end());
+  std::vector<std::pair<int64_t, uint64_t> > pairs;       // (count, key)
+  for(int64_t i = 0, run = 1; i < transfers; i++, run++){
+    if(i + 1 == transfers || keys[i+1] != keys[i]){
+      pairs.push_back(std::make_pair(run, keys[i]));
+      run = 0;
+    }
+  }
+  std::sort(pairs.rbegin(), pairs.rend());
+  int64_t topPercent = 0, hotPairs = std::max<int64_t>(1, pairs.size() / 100);
+  for(int64_t i = 0; i < hotPairs; i++){
+    topPercent += pairs[i].first;
+  }
+  print_output("Account pairs: " << pairs.size() << " distinct, " << std::fixed \
+    << std::setprecision(2) << (double) transfers / pairs.size() \
+    << " transfer(s) per pair; the top 1% carry " << percent((double) topPercent / transfers));
+  for(int64_t i = 0; i < std::min<int64_t>(top, pairs.size()); i++){
+    print_output("  hot pair " << load.accounts[pairs[i].second >> 32] << " <-> " \
+      << load.accounts[pairs[i].second & 0xffffffffULL] << ": " << pairs[i].first \
+      << " transfer(s), " << percent((double) pairs[i].first / transfers));
+  }
+}
+
+// -- transfers per request the coalescer gets out of the input
+static double coalesceRatio(const workload_t &load, int64_t window, coalesceMode mode)
+{
+  transferCoalescer_t coalescer;
+  coalescer.init(window, mode);
+  std::vector<EFTRequest_t> requests;
+  int64_t produced = 0;
+  for(size_t i = 0; i < load.transfers.size(); i++){
+    if(coalescer.addTransfer(load.transfers[i].fromAccount, load.transfers[i].toAccount, \
+       load.transfers[i].transferAmount) == true){
+      coalescer.flush(requests);
+      produced += requests.size();
+      requests.clear();
+    }
+  }
+  coalescer.flush(requests);
+  produced += requests.size();
+  return load.transfers.empty() ? 1.0 : (double) load.transfers.size() / std::max<int64_t>(produced, 1);
+}
+
+// -- conflict rates, coalescing, and the settings they point to
+static void recommend(const char *fileName, const workload_t &load, \
+  const analyzeOptions_t &options)
+{
+  int64_t cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int64_t maxWorkers = std::max<int64_t>(1, std::min<int64_t>(cpus - 1, MAX_WORKERS));
+  std::vector<transferPair_t> sample(load.transfers.begin(), load.transfers.begin() + \
+    std::min<size_t>(load.transfers.size(), CONFLICT_SAMPLE_TRANSFERS));
+
+  print_output("Conflict rate (transfers sharing an account with a concurrent one, " \
+    << sample.size() << " sampled):");
+  for(int64_t workers = 2; workers <= std::max<int64_t>(maxWorkers, 8); workers *= 2){
+    print_output("  " << std::setw(5) << workers << " worker(s): " \
+      << percent(estimateConflictRate(sample, workers)));
+  }
+  if(options.workers > 1){
+    print_output("  " << std::setw(5) << options.workers << " worker(s): " \
+      << percent(estimateConflictRate(sample, options.workers)) << " (requested)");
+  }
+
+  // Best coalescing (the smaller window and pair netting on a tie)
+  int64_t windows[] = COALESCE_WINDOWS;
+  int64_t bestWindow = 0;
+  coalesceMode bestMode = COALESCE_PAIR;
+  double bestRatio = 1.0;
+  print_output("Coalescing (transfers per request):");
+  for(size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++){
+    double pairRatio = coalesceRatio(load, windows[w], COALESCE_PAIR);
+    double accountRatio = coalesceRatio(load, windows[w], COALESCE_ACCOUNT);
+    print_output("  window " << std::setw(5) << windows[w] << ": pair " << std::fixed \
+      << std::setprecision(2) << pairRatio << " , account " << accountRatio);
+    if(pairRatio > bestRatio * 1.05){
+      bestRatio = pairRatio, bestWindow = windows[w], bestMode = COALESCE_PAIR;
+    }
+    if(accountRatio > bestRatio * 1.05){
+      bestRatio = accountRatio, bestWindow = windows[w], bestMode = COALESCE_ACCOUNT;
+    }
+  }
+
+  // Settings: the workers the conflict rate allows (as "auto" picks them);
+  // no locking at all when contention caps them and the deltas are small;
+  // the sequential engine when there's nothing to share out
+  int64_t workers = recommendWorkers(sample, maxWorkers, AUTO_MAX_CONFLICT_RATE);
+  bool reduce = (workers < maxWorkers && load.accounts.size() <= REDUCE_MAX_ACCOUNTS);
+  if(reduce == true){
+    workers = maxWorkers;
+  }
+  bool sequential = (workers == 1 || \
+    (load.inputBytes >= 0 && load.inputBytes < SEQUENTIAL_INPUT_SIZE));
+  std::stringstream command, reasons;
+  command << "./transfProg " << fileName;
+  if(sequential == true){
+    command << " 1 --mode sequential";
+    reasons << "  one worker: " << (maxWorkers == 1 ? "no cpu to spare for a second one" : \
+      (workers == 1 ? "the transfers contend at 2 workers already" : \
+      "the input is too small to pay for forking")) << "\n";
+  }
+  else {
+    command << " " << workers;
+    reasons << "  " << workers << " worker(s) of " << cpus << " cpu(s)";
+    if(reduce == true){
+      command << " --reduce";
+      reasons << ", with --reduce: contention would cap the workers at " \
+        << recommendWorkers(sample, maxWorkers, AUTO_MAX_CONFLICT_RATE) \
+        << " and a delta per account is only " << load.accounts.size() * 8 / 1024 \
+        << " KiB per worker (not with --daemon)";
+    }
+    reasons << "\n";
+    if(workers + 1 < cpus){
+      command << " --queue poll";
+      reasons << "  --queue poll: there is a spare cpu for every worker\n";
+    }
+  }
+  // (netting only saves queue traffic; the sequential engine has none)
+  if(sequential == false && bestRatio >= COALESCE_MIN_RATIO){
+    command << " --coalesce " << bestWindow;
+    if(bestMode == COALESCE_ACCOUNT){
+      command << " --coalesce-mode account";
+    }
+    reasons << "  --coalesce: " << std::fixed << std::setprecision(2) << bestRatio \
+      << " transfers per request" << (load.urgent > 0 ? " (urgent ones bypass it)" : "") << "\n";
+  }
+  print_output("Recommended:");
+  print_output("  " << command.str());
+  std::cout << reasons.str();
+}
+
+static void printUsage()
+{
+  print_output("USAGE:");
+  print_output("\t./eftAnalyze <PathToInputFile|-> [options]");
+  print_output("OPTIONS:");
+  print_output("\t--workers <n>     also report the conflict rate for <n> workers");
+  print_output("\t--top <n>         hot accounts and pairs listed (default 5)");
+}
+
+
+// ------------------------ main() ------------------------------
+int main(int argc, char *argv[])
+{
+  analyzeOptions_t options = { 0, 5 };
+  static struct option longOptions[] = {
+    { "workers", required_argument, NULL, 'w' },
+    { "top",     required_argument, NULL, 't' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt = 0;
+  while((opt = getopt_long(argc, argv, "w:t:", longOptions, NULL)) != -1)
+  {
+    switch(opt){
+      case 'w': options.workers = atoll(optarg); break;
+      case 't': options.top = atoll(optarg); break;
+      default:
+        printUsage();
+        return 0;
+    }
+  }
+  if(argc - optind != 1 || options.workers < 0 || options.top < 0){
+    printUsage();
+    return 0;
+  }
+  selectLineParser(PARSER_AUTO);
+
+  workload_t load = { 0, std::vector<int64_t>(), 0, 0, std::vector<transferPair_t>(), \
+    0, 0, 0, 0, -1 };
+  int64_t startNs = monotonicNs();
+  if(scanInput(argv[optind], load) == false){
+    return 1;
+  }
+  print_output("Input: " << argv[optind] << " (scanned in " << std::fixed \
+    << std::setprecision(3) << (monotonicNs() - startNs) / 1e9 << " s)");
+  reportAccounts(load);
+  reportDegrees(load, options.top);
+  reportPairs(load, options.top);
+  recommend(argv[optind], load, options);
+  return 0;
+}
@@ -0,0 +1,460 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T10:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: eftBench.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T10:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "debugMacros.hpp"
+#include "bankAccount.hpp"
+#include "workerQueue.hpp"
+#include "lineParser.hpp"
+
+
+// Std namespace
+using namespace std;
+
+// Benchmark settings (overridable from the command line)
+typedef struct benchOptions {
+  int64_t repetitions;            // measured runs per case
+  int64_t operations;             // operations per run
+  int64_t maxAccounts;            // largest pool for the lookup cases
+  uint64_t seed;                  // seed for every random key sequence
+} benchOptions_t;
+
+// Summary of the repetitions of one case (ns per operation)
+typedef struct benchResult {
+  double mean;
+  double stddev;
+  double min;
+  double max;
+} benchResult_t;
+
+
+// -- monotonic clock in nanoseconds
+static inline int64_t nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// -- map anonymous memory shared with forked children
+static void* mapShared(size_t size)
+{
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, \
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(memory == MAP_FAILED){
+    print_output("(eftBench) Failed to map shared memory! *ABORT*");
+    exit(1);
+  }
+  return memory;
+}
+
+// -- mean / stddev / min / max over the per-run samples
+static benchResult_t summarize(const vector<double> &samples)
+{
+  benchResult_t result = { 0, 0, 0, 0 };
+  if(samples.empty()){
+    return result;
+  }
+  double sum = 0;
+  result.min = samples[0];
+  result.max = samples[0];
+  for(size_t i = 0; i < samples.size(); i++){
+    sum += samples[i];
+    result.min = std::min(result.min, samples[i]);
+    result.max = std::max(result.max, samples[i]);
+  }
+  result.mean = sum / samples.size();
+  double variance = 0;
+  for(size_t i = 0; i < samples.size(); i++){
+    variance += (samples[i] - result.mean) * (samples[i] - result.mean);
+  }
+  result.stddev = sqrt(variance / samples.size());
+  return result;
+}
+
+static void printHeader(const char *title)
+{
+  print_output("");
+  print_output("== " << title << " ==");
+  print_output(std::left << std::setw(36) << "case" << std::right \
+    << std::setw(12) << "mean(ns)" << std::setw(12) << "stddev" \
+    << std::setw(12) << "min" << std::setw(12) << "max" \
+    << std::setw(14) << "Mops/s");
+}
+
+static void printResult(const string &name, const benchResult_t &result)
+{
+  double mops = (result.mean > 0) ? (1000.0 / result.mean) : 0;
+  print_output(std::left << std::setw(36) << name << std::right << std::fixed \
+    << std::setprecision(1) << std::setw(12) << result.mean \
+    << std::setw(12) << result.stddev << std::setw(12) << result.min \
+    << std::setw(12) << result.max << std::setprecision(3) \
+    << std::setw(14) << mops);
+}
+
+// Runs one case: a warm-up run followed by the measured repetitions.
+// The case returns the ns per operation of a single run.
+template <typename benchCase>
+static benchResult_t runCase(const benchOptions_t &options, benchCase body)
+{
+  vector<double> samples;
+  body();
+  for(int64_t rep = 0; rep < options.repetitions; rep++){
+    samples.push_back(body());
+  }
+  return summarize(samples);
+}
+
+
+// ------------------------ workerQueue ------------------------------
+
+// push/pop from the same process (no contention on the semaphores)
+static double queueLocalThroughput(workerQueue_t *queue, int64_t operations)
+{
+  EFTRequest_t request = { 0, 1, 2, 3 };
+  int64_t capacity = queue->getCapacity();
+  int64_t start = nowNs();
+  for(int64_t done = 0; done < operations; done += capacity){
+    for(int64_t i = 0; i < capacity; i++){
+      queue->pushRequest(&request);
+    }
+    for(int64_t i = 0; i < capacity; i++){
+      request = queue->popRequest();
+    }
+  }
+  return (double) (nowNs() - start) / operations;
+}
+
+// producer (parent) and consumer (forked child) on the same queue
+static double queueCrossProcessThroughput(workerQueue_t *queue, int64_t operations)
+{
+  EFTRequest_t request = { 0, 1, 2, 3 };
+  pid_t consumer = fork();
+  if(consumer < 0){
+    print_output("(eftBench) Failed to fork the consumer!");
+    exit(1);
+  }
+  if(consumer == 0){
+    for(int64_t i = 0; i < operations; i++){
+      request = queue->popRequest();
+    }
+    _exit(EXIT_SUCCESS);
+  }
+  int64_t start = nowNs();
+  for(int64_t i = 0; i < operations; i++){
+    queue->pushRequest(&request);
+  }
+  waitpid(consumer, NULL, 0);
+  return (double) (nowNs() - start) / operations;
+}
+
+// round trip: parent -> child on "ping", child -> parent on "pong"
+static double queuePingPongLatency(workerQueue_t *ping, workerQueue_t *pong, \
+  int64_t operations)
+{
+  EFTRequest_t request = { 0, 1, 2, 3 };
+  pid_t echo = fork();
+  if(echo < 0){
+    print_output("(eftBench) Failed to fork the echo process!");
+    exit(1);
+  }
+  if(echo == 0){
+    for(int64_t i = 0; i < operations; i++){
+      request = ping->popRequest();
+      pong->pushRequest(&request);
+    }
+    _exit(EXIT_SUCCESS);
+  }
+  int64_t start = nowNs();
+  for(int64_t i = 0; i < operations; i++){
+    ping->pushRequest(&request);
+    request = pong->popRequest();
+  }
+  int64_t elapsed = nowNs() - start;
+  waitpid(echo, NULL, 0);
+  return (double) elapsed / operations;
+}
+
+static void benchWorkerQueue(const benchOptions_t &options)
+{
+  workerQueue_t *queues = (workerQueue_t *) mapShared(2 * sizeof(workerQueue_t));
+  const int64_t capacities[] = { 1, 2, 4, 8, MAX_WORKER_BUFFERSIZE };
+
+  printHeader("workerQueue");
+  for(size_t c = 0; c < sizeof(capacities)/sizeof(capacities[0]); c++)
+  {
+    int64_t capacity = capacities[c];
+    queues[0].init(capacity);
+    queues[1].init(capacity);
+    string suffix = " (cap " + std::to_string(capacity) + ")";
+
+    printResult("push+pop local" + suffix, runCase(options, [&]() {
+      return queueLocalThroughput(&queues[0], options.operations);
+    }));
+    printResult("push->pop 2 procs" + suffix, runCase(options, [&]() {
+      return queueCrossProcessThroughput(&queues[0], options.operations);
+    }));
+    printResult("ping-pong RTT" + suffix, runCase(options, [&]() {
+      return queuePingPongLatency(&queues[0], &queues[1], options.operations / 10);
+    }));
+
+    queues[0].destroy();
+    queues[1].destroy();
+  }
+  munmap(queues, 2 * sizeof(workerQueue_t));
+}
+
+
+// ------------------------ bankAccountPool ------------------------------
+
+// Looks up every key once in the given order
+static double poolLookup(bankAccountPool_t *pool, const vector<int64_t> &keys)
+{
+  int64_t checksum = 0;
+  int64_t start = nowNs();
+  for(size_t i = 0; i < keys.size(); i++){
+    checksum += pool->at(keys[i])->getBalance();
+  }
+  int64_t elapsed = nowNs() - start;
+  // keep the loop from being optimized out
+  if(checksum == -1){
+    print_output("checksum: " << checksum);
+  }
+  return (double) elapsed / keys.size();
+}
+
+static void benchAccountPool(const benchOptions_t &options)
+{
+  printHeader("bankAccountPool::at()");
+  for(int64_t accounts = 1000; accounts <= options.maxAccounts; accounts *= 10)
+  {
+    std::mt19937_64 generator(options.seed);
+    int64_t lookups = std::min(options.operations, accounts * 10);
+    string suffix = " (" + std::to_string(accounts) + " accts)";
+
+    // Dense keys 1..N, inserted in ascending order like the test files
+    vector<int64_t> keys(accounts);
+    for(int64_t i = 0; i < accounts; i++){
+      keys[i] = i + 1;
+    }
+    vector<int64_t> sequential(lookups), random(lookups);
+    std::uniform_int_distribution<int64_t> pick(0, accounts - 1);
+    for(int64_t i = 0; i < lookups; i++){
+      sequential[i] = keys[i % accounts];
+      random[i] = keys[pick(generator)];
+    }
+
+    bankAccountPool_t pool;
+    pool.initPool(accounts);
+    for(int64_t i = 0; i < accounts; i++){
+      pool.addAccount(keys[i], i);
+    }
+    printResult("sequential" + suffix, runCase(options, [&]() {
+      return poolLookup(&pool, sequential);
+    }));
+    printResult("random" + suffix, runCase(options, [&]() {
+      return poolLookup(&pool, random);
+    }));
+    pool.deInitPool();
+
+    // Sparse keys: random gaps of up to 1000 between account numbers,
+    // inserted in shuffled order
+    int64_t next = 0;
+    std::uniform_int_distribution<int64_t> gap(1, 1000);
+    for(int64_t i = 0; i < accounts; i++){
+      next += gap(generator);
+      keys[i] = next;
+    }
+    vector<int64_t> insertOrder(keys);
+    std::shuffle(insertOrder.begin(), insertOrder.end(), generator);
+    for(int64_t i = 0; i < lookups; i++){
+      random[i] = keys[pick(generator)];
+    }
+
+    pool.initPool(accounts);
+    for(int64_t i = 0; i < accounts; i++){
+      pool.addAccount(insertOrder[i], i);
+    }
+    printResult("sparse random" + suffix, runCase(options, [&]() {
+      return poolLookup(&pool, random);
+    }));
+    pool.deInitPool();
+  }
+}
+
+
+// ------------------------ bankAccount ------------------------------
+
+static double accountLockUncontended(bankAccount_t *account, int64_t operations)
+{
+  int64_t start = nowNs();
+  for(int64_t i = 0; i < operations; i++){
+    account->lock();
+    account->setBalance(account->getBalance() + 1);
+    account->unlock();
+  }
+  return (double) (nowNs() - start) / operations;
+}
+
+// "processes" processes increment the same account concurrently
+static double accountLockContended(bankAccount_t *account, int64_t operations, \
+  int64_t processes)
+{
+  vector<pid_t> children;
+  int64_t start = nowNs();
+  for(int64_t p = 0; p < processes; p++){
+    pid_t child = fork();
+    if(child < 0){
+      print_output("(eftBench) Failed to fork a locker!");
+      exit(1);
+    }
+    if(child == 0){
+      accountLockUncontended(account, operations);
+      _exit(EXIT_SUCCESS);
+    }
+    children.push_back(child);
+  }
+  for(size_t p = 0; p < children.size(); p++){
+    waitpid(children[p], NULL, 0);
+  }
+  return (double) (nowNs() - start) / (operations * processes);
+}
+
+static void benchAccountLock(const benchOptions_t &options)
+{
+  bankAccount_t *account = (bankAccount_t *) mapShared(sizeof(bankAccount_t));
+  account->init();
+  account->setBalance(0);
+
+  printHeader("bankAccount lock/unlock");
+  printResult("uncontended", runCase(options, [&]() {
+    return accountLockUncontended(account, options.operations);
+  }));
+  for(int64_t processes = 2; processes <= 4; processes *= 2){
+    printResult("contended (" + std::to_string(processes) + " procs)", \
+      runCase(options, [&]() {
+        return accountLockContended(account, options.operations / processes, processes);
+    }));
+  }
+
+  account->destroy();
+  munmap(account, sizeof(bankAccount_t));
+}
+
+
+// ------------------------ lineParser ------------------------------
+
+// lines are NUL terminated, one after the other in text (as in the input
+// reader's buffers)
+static double parseLines(const string &text, const vector<size_t> &lines)
+{
+  int64_t checksum = 0;
+  int64_t start = nowNs();
+  for(size_t i = 0; i + 1 < lines.size(); i++){
+    int64_t fields[4] = { -1, -1, 0, 0 };
+    parseLineFields(text.data() + lines[i], lines[i+1] - lines[i] - 1, true, fields, 4);
+    checksum += fields[0] + fields[1] + fields[2];
+  }
+  double nsPerLine = (double) (nowNs() - start) / (lines.size() - 1);
+  // (keeps the parsing from being optimized away)
+  if(checksum == 42){
+    print_output("");
+  }
+  return nsPerLine;
+}
+
+static void benchLineParser(const benchOptions_t &options)
+{
+  // Transfer lines as in the test files, with up to 7 digit accounts
+  std::mt19937_64 generator(options.seed);
+  std::uniform_int_distribution<int64_t> account(0, 9999999);
+  std::uniform_int_distribution<int64_t> amount(1, 999);
+  string text;
+  vector<size_t> lines;
+  for(int64_t i = 0; i < options.operations; i++){
+    lines.push_back(text.size());
+    text += "Transfer " + std::to_string(account(generator)) + " " + \
+      std::to_string(account(generator)) + " " + std::to_string(amount(generator));
+    text.push_back('\0');
+  }
+  lines.push_back(text.size());
+
+  printHeader("lineParser transfer lines");
+  const int64_t parsers[] = { PARSER_SCALAR, PARSER_SSE42, PARSER_AVX2 };
+  for(size_t i = 0; i < sizeof(parsers) / sizeof(parsers[0]); i++){
+    // (skipped when the cpu doesn't have it)
+    if(selectLineParser(parsers[i]) != parsers[i]){
+      continue;
+    }
+    printResult(lineParserName(parsers[i]), runCase(options, [&]() {
+      return parseLines(text, lines);
+    }));
+  }
+  selectLineParser(PARSER_AUTO);
+}
+
+
+// ------------------------ main() ------------------------------
+int main(int argc, char *argv[])
+{
+  benchOptions_t options = { 5, 1000000, 1000000, 42 };
+  static struct option longOptions[] = {
+    { "reps",         required_argument, NULL, 'r' },
+    { "ops",          required_argument, NULL, 'n' },
+    { "max-accounts", required_argument, NULL, 'a' },
+    { "seed",         required_argument, NULL, 's' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt = 0;
+  while((opt = getopt_long(argc, argv, "r:n:a:s:", longOptions, NULL)) != -1)
+  {
+    switch(opt){
+      case 'r': options.repetitions = atoll(optarg); break;
+      case 'n': options.operations = atoll(optarg); break;
+      case 'a': options.maxAccounts = atoll(optarg); break;
+      case 's': options.seed = strtoull(optarg, NULL, 10); break;
+      default:
+        print_output("USAGE:");
+        print_output("\t./eftBench [--reps N] [--ops N] [--max-accounts N] [--seed N]");
+        print_output("\t(--max-accounts goes up to 100000000 in powers of 10)");
+        return 0;
+    }
+  }
+  if(options.repetitions < 1 || options.operations < 100 || options.maxAccounts < 1000){
+    print_output("Invalid options: need reps >= 1, ops >= 100, max-accounts >= 1000");
+    return 0;
+  }
+
+  print_output("eftBench: " << options.repetitions << " reps x " \
+    << options.operations << " ops, seed " << options.seed \
+    << ", " << sysconf(_SC_NPROCESSORS_ONLN) << " online cpu(s)");
+
+  benchWorkerQueue(options);
+  benchAccountPool(options);
+  benchAccountLock(options);
+  benchLineParser(options);
+
+  return 0;
+}
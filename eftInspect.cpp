@@ -0,0 +1,240 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T16:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: eftInspect.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T16:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "debugMacros.hpp"
+#include "sharedMemory.hpp"
+#include "sharedState.hpp"
+
+
+// Std namespace
+using namespace std;
+
+// Inspector settings
+typedef struct inspectOptions {
+  std::vector<int64_t> accounts;  // accounts whose balance is reported
+  bool allAccounts;               // report every account of the pool
+  double interval;                // seconds between reports (0: report once)
+  int64_t count;                  // reports to print in watch mode (0: until done)
+} inspectOptions_t;
+
+// What an attached transfProg looks like from here. Everything is mapped
+// read-only: nothing is locked and nothing is written, so the workers never
+// wait on the inspector (and the balances read are a live, unsynchronized view)
+typedef struct inspectView {
+  const char *name;
+  sharedStateHeader_t *header;
+  size_t stateSize;
+  bankAccountPool_t *accountPool;
+  processData_t *processData;
+  node_t *nodes;                  // pool segment, as mapped here
+  size_t poolSize;
+} inspectView_t;
+
+
+// -- rebases a node pointer of transfProg onto the pool mapped here
+// (NULL when it doesn't point at a node of the pool)
+static node_t* rebaseNode(const inspectView_t &view, node_t *remote)
+{
+  uintptr_t base = (uintptr_t) view.accountPool->getPoolMemory();
+  uintptr_t address = (uintptr_t) remote;
+  if(remote == NULL || address < base){
+    return NULL;
+  }
+  uintptr_t offset = address - base;
+  if(offset % sizeof(node_t) != 0 || offset + sizeof(node_t) > view.poolSize){
+    return NULL;
+  }
+  return view.nodes + offset / sizeof(node_t);
+}
+
+// -- looks an account up in the AVL tree of the pool
+static bankAccount_t* findAccount(const inspectView_t &view, int64_t accountNumber)
+{
+  node_t *node = rebaseNode(view, view.accountPool->getPoolHandle());
+  // (the depth bound guards against reading a tree that is being rebuilt)
+  for(int depth = 0; node != NULL && depth < 128; depth++){
+    int64_t number = node->account.getAccountNumber();
+    if(number == accountNumber){
+      return &node->account;
+    }
+    node = rebaseNode(view, (accountNumber < number) ? node->left : node->right);
+  }
+  return NULL;
+}
+
+// -- attaches to the pool segment once transfProg has created it
+static bool attachPool(inspectView_t &view)
+{
+  if(view.nodes != NULL){
+    return true;
+  }
+  std::string segment = sharedSegmentName(view.name, POOL_SEGMENT_SUFFIX);
+  view.nodes = (node_t *) attachNamedSharedMemory(segment.c_str(), &view.poolSize);
+  return (view.nodes != NULL);
+}
+
+// -- attaches to the control segment
+static bool attach(inspectView_t &view)
+{
+  std::string segment = sharedSegmentName(view.name);
+  void *state = attachNamedSharedMemory(segment.c_str(), &view.stateSize);
+  if(state == NULL){
+    print_error("eftInspect: no shared memory segment " << segment \
+      << " (is transfProg running with --shm-name " << view.name << "?)");
+    return false;
+  }
+  view.header = (sharedStateHeader_t *) state;
+  if(view.stateSize < sharedProcessDataOffset() || \
+     __atomic_load_n(&view.header->magic, __ATOMIC_ACQUIRE) != SHARED_STATE_MAGIC || \
+     view.stateSize < sharedStateSize(view.header->numberOfWorkers)){
+    print_error("eftInspect: " << segment << " is not an EFT state segment");
+    return false;
+  }
+  view.accountPool = (bankAccountPool_t *) ((char *) state + sharedPoolOffset());
+  view.processData = (processData_t *) ((char *) state + sharedProcessDataOffset());
+  return true;
+}
+
+// -- prints one report; transfers holds the counters of the previous one
+static void report(inspectView_t &view, const inspectOptions_t &options, \
+  std::vector<int64_t> &transfers, int64_t &lastNs)
+{
+  const char *stages[] = { "loading accounts", "transfers", "done" };
+  int64_t now = monotonicNs();
+  int64_t stage = view.header->stage;
+  print_output("transfProg " << view.header->ownerPID << " , " \
+    << stages[(stage >= STAGE_LOADING && stage <= STAGE_DONE) ? stage : 0] \
+    << " , up " << std::fixed << std::setprecision(3) \
+    << (now - view.header->startNs) / 1e9 << " s");
+
+  bool poolReady = attachPool(view);
+  print_output("Accounts: " << (poolReady ? view.accountPool->getTotalAccounts() : 0));
+
+  // Workers: queue depth and transfers applied (rates since the last report,
+  // or since the start for the first one)
+  int64_t workers = view.header->numberOfWorkers;
+  double seconds = (now - lastNs) / 1e9;
+  int64_t total = 0, totalDelta = 0;
+  print_output("Worker  Queue    Transfers     Transfers/s");
+  for(int64_t i = 0; i < workers; i++){
+    processData_t *worker = &view.processData[i];
+    int64_t applied = __atomic_load_n(&worker->stats.transfers, __ATOMIC_RELAXED);
+    int64_t delta = applied - transfers[i];
+    transfers[i] = applied;
+    total += applied;
+    totalDelta += delta;
+    print_output(std::setw(6) << i << "  " << std::setw(2) \
+      << worker->EFTRequests.getDepth() << "/" << std::setw(2) \
+      << worker->EFTRequests.getCapacity() << "  " << std::setw(11) << applied \
+      << "  " << std::setw(14) << std::setprecision(0) << delta / seconds);
+  }
+  print_output(" total         " << std::setw(11) << total << "  " << std::setw(14) \
+    << std::setprecision(0) << totalDelta / seconds);
+  lastNs = now;
+
+  // Balances
+  if(poolReady == false){
+    return;
+  }
+  for(size_t i = 0; i < options.accounts.size(); i++){
+    bankAccount_t *account = findAccount(view, options.accounts[i]);
+    if(account == NULL){
+      print_output(options.accounts[i] << " not found");
+      continue;
+    }
+    print_output(options.accounts[i] << " " << account->getBalance());
+  }
+  if(options.allAccounts == true){
+    int64_t accounts = view.accountPool->getTotalAccounts();
+    for(int64_t slot = 0; slot < accounts && (slot + 1) * sizeof(node_t) <= view.poolSize; slot++){
+      print_output(view.nodes[slot].account.getAccountNumber() << " " \
+        << view.nodes[slot].account.getBalance());
+    }
+  }
+}
+
+static void printUsage()
+{
+  print_output("USAGE:");
+  print_output("\t./eftInspect <shm-name> [options]");
+  print_output("OPTIONS:");
+  print_output("\t--account <n>     report the balance of account <n> (repeatable)");
+  print_output("\t--all             report the balance of every account");
+  print_output("\t--watch <sec>     report every <sec> seconds until transfProg is done");
+  print_output("\t--count <n>       stop watching after <n> reports");
+}
+
+
+// ------------------------ main() ------------------------------
+int main(int argc, char *argv[])
+{
+  inspectOptions_t options = { std::vector<int64_t>(), false, 0, 0 };
+  static struct option longOptions[] = {
+    { "account", required_argument, NULL, 'a' },
+    { "all",     no_argument,       NULL, 'A' },
+    { "watch",   required_argument, NULL, 'w' },
+    { "count",   required_argument, NULL, 'c' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt = 0;
+  while((opt = getopt_long(argc, argv, "a:Aw:c:", longOptions, NULL)) != -1)
+  {
+    switch(opt){
+      case 'a': options.accounts.push_back(atoll(optarg)); break;
+      case 'A': options.allAccounts = true; break;
+      case 'w': options.interval = atof(optarg); break;
+      case 'c': options.count = atoll(optarg); break;
+      default:
+        printUsage();
+        return 0;
+    }
+  }
+  if(argc - optind != 1 || options.interval < 0){
+    printUsage();
+    return 0;
+  }
+
+  inspectView_t view = { argv[optind], NULL, 0, NULL, NULL, NULL, 0 };
+  if(attach(view) == false){
+    return 1;
+  }
+  std::vector<int64_t> transfers(view.header->numberOfWorkers, 0);
+  int64_t lastNs = view.header->startNs;
+
+  for(int64_t reports = 1; ; reports++){
+    report(view, options, transfers, lastNs);
+    // transfProg unlinks the segments when it is done; our mappings stay valid
+    bool ownerGone = (kill(view.header->ownerPID, 0) != 0);
+    if(options.interval == 0 || view.header->stage == STAGE_DONE || ownerGone || \
+       (options.count > 0 && reports >= options.count)){
+      break;
+    }
+    print_output("");
+    usleep((useconds_t) (options.interval * 1e6));
+  }
+
+  if(view.nodes != NULL){
+    munmap(view.nodes, view.poolSize);
+  }
+  munmap(view.header, view.stateSize);
+  return 0;
+}
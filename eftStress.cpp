@@ -0,0 +1,676 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T22:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: eftStress.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T22:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "debugMacros.hpp"
+#include "bankAccount.hpp"
+#include "transfProg.hpp"
+
+
+// Std namespace
+using namespace std;
+
+// Harness settings (overridable from the command line)
+typedef struct stressOptions {
+  const char *program;            // transfProg binary under test
+  int64_t accounts;               // accounts per workload
+  int64_t transfers;              // transfers per workload
+  std::vector<int64_t> workers;   // worker counts every configuration runs with
+  uint64_t seed;                  // seed of the first round
+  int64_t rounds;                 // rounds, each with new workloads
+  int64_t timeout;                // seconds before a run counts as hung
+  const char *only;               // run this workload only (NULL: all)
+  bool keep;                      // keep the inputs (failing ones are always kept)
+} stressOptions_t;
+
+// A generated input and its sequential reference
+typedef struct workload {
+  std::string name;
+  std::vector<accountRecord_t> accounts;    // listed in this order
+  size_t listedUpFront;                     // the others are opened among the transfers
+  bool countLine;                           // the input starts with the account count
+  std::vector<std::string> transfers;       // transfer lines
+  std::vector<int64_t> expected;            // final balance, per listed account
+  int64_t totalBalance;                     // money in the system (never changes)
+} workload_t;
+
+// A transfProg configuration under test
+typedef struct stressConfig {
+  const char *name;
+  const char *arguments;          // options passed to transfProg
+  bool sequential;                // run once, not per worker count
+  int64_t partitions;             // instances splitting the accounts (--partition)
+  const char *workload;           // the only workload it runs on (NULL: all)
+  bool withholdOpens;             // the last instance's input has no mid-stream Opens
+} stressConfig_t;
+
+static const stressConfig_t stressConfigs[] = {
+  { "sequential",       "--mode sequential", true, 1, NULL, false },
+  { "parallel",         "--mode parallel", false, 1, NULL, false },
+  { "batch",            "--mode parallel --batch 8", false, 1, NULL, false },
+  { "reduce",           "--mode parallel --reduce", false, 1, NULL, false },
+  { "spin",             "--mode parallel --lock spin", false, 1, NULL, false },
+  { "poll",             "--mode parallel --queue poll", false, 1, NULL, false },
+  { "coalesce",         "--mode parallel --coalesce 64", false, 1, NULL, false },
+  { "coalesce-account", "--mode parallel --coalesce 64 --coalesce-mode account", false, 1, NULL, false },
+  { "ordered",          "--mode parallel --ordered", false, 1, NULL, false },
+  { "partition-2",      "--mode parallel", false, 2, NULL, false },
+  { "partition-3",      "--mode parallel --batch 8", false, 3, NULL, false },
+  // (credits to the accounts the last instance never opens are refused,
+  // and refunded by the others)
+  { "partition-refund", "--mode parallel", false, 2, "grow", true },
+};
+
+// How a run went
+enum runStatus {
+  RUN_OK = 0,
+  RUN_WRONG = 1,                  // balances differ from the reference
+  RUN_NOT_CONSERVED = 2,          // and the money doesn't add up either
+  RUN_CRASHED = 3,                // non-zero exit or killed
+  RUN_HUNG = 4                    // killed after the timeout
+};
+
+
+// ------------------------ Workloads ------------------------------
+
+// Adds a transfer line and applies it to the reference; transfers with an
+// unknown account are rejected by transfProg, and leave the balances alone
+static void addTransfer(workload_t &load, std::unordered_map<int64_t, int64_t> &balances, \
+  int64_t from, int64_t to, int64_t amount, int64_t priority = 0)
+{
+  std::stringstream line;
+  line << "Transfer " << from << " " << to << " " << amount;
+  if(priority != 0){
+    line << " " << priority;
+  }
+  load.transfers.push_back(line.str());
+  std::unordered_map<int64_t, int64_t>::iterator fromAccount = balances.find(from);
+  std::unordered_map<int64_t, int64_t>::iterator toAccount = balances.find(to);
+  if(fromAccount == balances.end() || toAccount == balances.end()){
+    return;
+  }
+  fromAccount->second -= amount;
+  toAccount->second += amount;
+}
+
+// Adds a multi-leg transfer line (one debit, a credit per pair of legs) and
+// applies it to the reference; an unknown account rejects all of it
+static void addSplit(workload_t &load, std::unordered_map<int64_t, int64_t> &balances, \
+  int64_t from, const std::vector<std::pair<int64_t, int64_t> > &credits)
+{
+  std::stringstream line;
+  line << "Split " << from;
+  bool known = (balances.count(from) > 0);
+  for(size_t i = 0; i < credits.size(); i++){
+    line << " " << credits[i].first << " " << credits[i].second;
+    known = known && (balances.count(credits[i].first) > 0);
+  }
+  load.transfers.push_back(line.str());
+  for(size_t i = 0; known && i < credits.size(); i++){
+    balances[from] -= credits[i].second;
+    balances[credits[i].first] += credits[i].second;
+  }
+}
+
+// Adds an Open line for an account (twice, when again is set: the second
+// one is ignored) and lists the account from there on
+static void addOpen(workload_t &load, int64_t number, int64_t balance, bool again)
+{
+  std::stringstream line;
+  line << "Open " << number << " " << balance;
+  load.transfers.push_back(line.str());
+  if(again == true){
+    std::stringstream duplicate;
+    duplicate << "Open " << number << " " << balance + 1;
+    load.transfers.push_back(duplicate.str());
+  }
+  accountRecord_t record = { number, balance };
+  load.accounts.push_back(record);
+  load.totalBalance += balance;
+}
+
+// Builds one of the workloads: the accounts (in a shuffled order), the
+// transfer lines and the balances a sequential run must end with
+static workload_t makeWorkload(const std::string &name, const stressOptions_t &options, \
+  std::mt19937_64 &generator)
+{
+  workload_t load;
+  load.name = name;
+  load.totalBalance = 0;
+  int64_t accounts = std::max<int64_t>(options.accounts, 16);
+  std::uniform_int_distribution<int64_t> balance(0, 1000000);
+  std::uniform_int_distribution<int64_t> amount(1, 5000);
+
+  // "sparse" uses large scattered numbers; the others 1..accounts
+  std::vector<int64_t> numbers;
+  std::uniform_int_distribution<int64_t> sparseNumber(1, (int64_t) 1 << 40);
+  std::unordered_map<int64_t, int64_t> balances;
+  while((int64_t) numbers.size() < accounts){
+    int64_t number = (name == "sparse") ? sparseNumber(generator) : numbers.size() + 1;
+    if(balances.insert(std::make_pair(number, balance(generator))).second){
+      numbers.push_back(number);
+    }
+  }
+  std::vector<int64_t> listed(numbers);
+  std::shuffle(listed.begin(), listed.end(), generator);
+  // "grow" lists half of them up front, without a count line, and opens
+  // the others along the way
+  size_t upFront = (name == "grow") ? listed.size() / 2 : listed.size();
+  load.listedUpFront = upFront;
+  load.countLine = (name != "grow");
+  std::vector<int64_t> opened(listed.begin(), listed.begin() + upFront);
+  for(size_t i = 0; i < upFront; i++){
+    accountRecord_t record = { listed[i], balances[listed[i]] };
+    load.accounts.push_back(record);
+    load.totalBalance += record.balance;
+  }
+
+  std::uniform_int_distribution<int64_t> anyAccount(0, accounts - 1);
+  std::uniform_int_distribution<int64_t> hotAccount(0, 7);
+  std::uniform_int_distribution<int64_t> percent(0, 99);
+  for(int64_t i = 0; i < options.transfers; i++)
+  {
+    int64_t from = numbers[anyAccount(generator)], to = numbers[anyAccount(generator)];
+    int64_t priority = 0;
+    if(name == "one-pair"){
+      // every transfer on the same two accounts, both ways
+      from = numbers[i % 2], to = numbers[(i + 1) % 2];
+    }
+    else if(name == "chain"){
+      // a -> b, b -> c, c -> d, ...: each transfer shares an account with
+      // the one before it
+      from = numbers[i % accounts], to = numbers[(i + 1) % accounts];
+      if((i + 1) % accounts == 0){
+        continue;
+      }
+    }
+    else if(name == "cycle"){
+      // a ring of 8 accounts passing the same amount around
+      from = numbers[i % 8], to = numbers[(i + 1) % 8];
+      addTransfer(load, balances, from, to, 100);
+      continue;
+    }
+    else if(name == "hot"){
+      // 90% of the transfers among 8 accounts
+      if(percent(generator) < 90){
+        from = numbers[hotAccount(generator)], to = numbers[hotAccount(generator)];
+      }
+    }
+    else if(name == "split"){
+      // multi-leg transfers, with repeated credits and credits to the
+      // debited account, between plain transfers on the same accounts
+      if(i % 2 == 0){
+        std::vector<std::pair<int64_t, int64_t> > credits;
+        int64_t legs = 1 + percent(generator) % MAX_TRANSFER_LEGS;
+        for(int64_t leg = 0; leg < legs; leg++){
+          int64_t credit = (percent(generator) < 50) ? numbers[hotAccount(generator)] : \
+            numbers[anyAccount(generator)];
+          credits.push_back(std::make_pair(percent(generator) < 5 ? from : credit, \
+            amount(generator)));
+        }
+        addSplit(load, balances, from, credits);
+        continue;
+      }
+      from = numbers[hotAccount(generator)];
+    }
+    else if(name == "grow"){
+      // accounts opened evenly among the transfers, which only use the
+      // accounts open so far
+      size_t due = upFront + (listed.size() - upFront) * (i + 1) / options.transfers;
+      while(opened.size() < due){
+        int64_t number = listed[opened.size()];
+        addOpen(load, number, balances[number], percent(generator) < 10);
+        opened.push_back(number);
+      }
+      std::uniform_int_distribution<size_t> openAccount(0, opened.size() - 1);
+      from = opened[openAccount(generator)], to = opened[openAccount(generator)];
+    }
+    else if(name == "mixed"){
+      // urgent transfers, same-account transfers and unknown accounts
+      int64_t kind = percent(generator);
+      if(kind < 20){
+        priority = 1 + kind % 3;
+      }
+      else if(kind < 25){
+        to = from;
+      }
+      else if(kind < 28){
+        to = numbers.back() + 1 + kind;
+      }
+    }
+    addTransfer(load, balances, from, to, amount(generator), priority);
+  }
+
+  for(size_t i = 0; i < load.accounts.size(); i++){
+    load.expected.push_back(balances[load.accounts[i].number]);
+  }
+  return load;
+}
+
+// Writes a workload in the input format of transfProg (without the Open
+// lines among the transfers with withholdOpens)
+static bool writeWorkload(const workload_t &load, const std::string &path, \
+  bool withholdOpens = false)
+{
+  std::ofstream file(path.c_str());
+  if(load.countLine == true){
+    file << load.accounts.size() << "\n";
+  }
+  for(size_t i = 0; i < load.listedUpFront; i++){
+    file << load.accounts[i].number << " " << load.accounts[i].balance << "\n";
+  }
+  bool started = false;
+  for(size_t i = 0; i < load.transfers.size(); i++){
+    bool open = (load.transfers[i][0] == 'O');
+    started = started || open == false;
+    if(withholdOpens == false || open == false || started == false){
+      file << load.transfers[i] << "\n";
+    }
+  }
+  return file.good();
+}
+
+// The workload as read without the Open lines among its transfers: the
+// accounts they open are never listed, and the transfers on them are
+// rejected
+static workload_t withoutOpens(const workload_t &load)
+{
+  workload_t reduced = load;
+  reduced.accounts.resize(load.listedUpFront);
+  reduced.transfers.clear();
+  reduced.expected.clear();
+  reduced.totalBalance = 0;
+  std::unordered_map<int64_t, int64_t> balances;
+  for(size_t i = 0; i < reduced.accounts.size(); i++){
+    balances.insert(std::make_pair(reduced.accounts[i].number, reduced.accounts[i].balance));
+    reduced.totalBalance += reduced.accounts[i].balance;
+  }
+  bool started = false;
+  for(size_t i = 0; i < load.transfers.size(); i++)
+  {
+    std::stringstream line(load.transfers[i]);
+    std::string kind;
+    int64_t first = 0, second = 0, third = 0;
+    line >> kind >> first >> second;
+    if(kind == "Open"){
+      // (the accounts opened before the first transfer are still listed)
+      if(started == false && balances.insert(std::make_pair(first, second)).second){
+        accountRecord_t record = { first, second };
+        reduced.accounts.push_back(record);
+        reduced.totalBalance += second;
+      }
+      continue;
+    }
+    started = true;
+    if(kind == "Transfer" && (line >> third)){
+      addTransfer(reduced, balances, first, second, third);
+    }
+    else {
+      // Split <from> <to> <amount> ...
+      std::vector<std::pair<int64_t, int64_t> > credits(1, std::make_pair(second, 0));
+      line >> credits[0].second;
+      for(int64_t to = 0, amount = 0; line >> to >> amount; ){
+        credits.push_back(std::make_pair(to, amount));
+      }
+      addSplit(reduced, balances, first, credits);
+    }
+  }
+  for(size_t i = 0; i < reduced.accounts.size(); i++){
+    reduced.expected.push_back(balances[reduced.accounts[i].number]);
+  }
+  return reduced;
+}
+
+
+// ------------------------ Runs ------------------------------
+
+// Starts transfProg on the input, in its own process group so that a hung
+// run is killed with its workers; returns its pid (-1 if it didn't start)
+static pid_t startProgram(const stressOptions_t &options, const std::string &input, \
+  int64_t workers, const std::string &arguments, const std::string &output)
+{
+  std::vector<std::string> words;
+  words.push_back(options.program);
+  words.push_back(input);
+  words.push_back(std::to_string(workers));
+  std::stringstream extra(arguments);
+  for(std::string word; extra >> word; ){
+    words.push_back(word);
+  }
+  words.push_back("--output");
+  words.push_back(output);
+  std::vector<char *> argv;
+  for(size_t i = 0; i < words.size(); i++){
+    argv.push_back((char *) words[i].c_str());
+  }
+  argv.push_back(NULL);
+
+  pid_t child = fork();
+  if(child == 0){
+    setpgid(0, 0);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    dup2(devNull, STDERR_FILENO);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+  if(child > 0){
+    setpgid(child, child);
+  }
+  return child;
+}
+
+// Waits for the runs started at startNs; returns RUN_OK when they all
+// exited normally in time, and the wall time they took
+static int64_t waitPrograms(const stressOptions_t &options, const std::vector<pid_t> &children, \
+  int64_t startNs, int64_t *elapsedNs)
+{
+  int64_t result = RUN_OK;
+  int64_t deadlineNs = startNs + options.timeout * 1000000000LL;
+  for(size_t i = 0; i < children.size(); i++)
+  {
+    int status = 0;
+    if(children[i] < 0){
+      result = std::max<int64_t>(result, RUN_CRASHED);
+      continue;
+    }
+    while(waitpid(children[i], &status, WNOHANG) == 0){
+      if(monotonicNs() > deadlineNs){
+        // (the others are killed with it)
+        for(size_t k = i; k < children.size(); k++){
+          if(children[k] > 0){
+            kill(-children[k], SIGKILL);
+          }
+        }
+        waitpid(children[i], &status, 0);
+        result = RUN_HUNG;
+        break;
+      }
+      usleep(1000);
+    }
+    if(result != RUN_HUNG && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)){
+      result = RUN_CRASHED;
+    }
+  }
+  *elapsedNs = monotonicNs() - startNs;
+  return result;
+}
+
+// Runs transfProg on the input; returns RUN_OK when it exited normally in
+// time, and the wall time it took
+static int64_t runProgram(const stressOptions_t &options, const std::string &input, \
+  int64_t workers, const char *arguments, const std::string &output, int64_t *elapsedNs)
+{
+  int64_t startNs = monotonicNs();
+  std::vector<pid_t> children(1, startProgram(options, input, workers, arguments, output));
+  return waitPrograms(options, children, startNs, elapsedNs);
+}
+
+// Runs the config's instances of transfProg on the input (the last on
+// lastInput) in a directory of their own, and writes their balances, in
+// the order of the instances, to output
+static int64_t runPartitions(const stressOptions_t &options, const std::string &input, \
+  const std::string &lastInput, int64_t workers, const stressConfig_t &config, \
+  const std::string &output, int64_t *elapsedNs)
+{
+  std::string directory = output + ".sockets";
+  mkdir(directory.c_str(), 0700);
+  int64_t startNs = monotonicNs();
+  std::vector<pid_t> children;
+  for(int64_t i = 0; i < config.partitions; i++)
+  {
+    std::stringstream arguments;
+    arguments << config.arguments << " --partition " << i << "/" << config.partitions \
+      << " --partition-dir " << directory;
+    children.push_back(startProgram(options, (i == config.partitions - 1) ? lastInput : input, \
+      workers, arguments.str(), output + "." + std::to_string(i)));
+  }
+  int64_t status = waitPrograms(options, children, startNs, elapsedNs);
+
+  std::ofstream file(output.c_str());
+  for(int64_t i = 0; i < config.partitions; i++)
+  {
+    std::string part = output + "." + std::to_string(i);
+    std::ifstream balances(part.c_str());
+    if(balances.peek() != std::ifstream::traits_type::eof()){
+      file << balances.rdbuf();
+    }
+    unlink(part.c_str());
+  }
+  // (the sockets of killed instances are left behind)
+  for(int64_t i = 0; i < config.partitions; i++){
+    unlink((directory + "/partition-" + std::to_string(i) + ".sock").c_str());
+  }
+  rmdir(directory.c_str());
+  return status;
+}
+
+// Compares the balances written by transfProg with the reference, and the
+// money they add up to with what the workload started with
+static int64_t checkOutput(const workload_t &load, const std::string &output)
+{
+  std::ifstream file(output.c_str());
+  int64_t number = 0, balance = 0, total = 0;
+  bool same = true;
+  size_t lines = 0;
+  while(file >> number >> balance){
+    if(lines >= load.accounts.size() || number != load.accounts[lines].number || \
+       balance != load.expected[lines]){
+      same = false;
+    }
+    total += balance;
+    ++lines;
+  }
+  if(lines != load.accounts.size()){
+    same = false;
+  }
+  if(same == true){
+    return RUN_OK;
+  }
+  return (total == load.totalBalance && lines == load.accounts.size()) ? \
+    RUN_WRONG : RUN_NOT_CONSERVED;
+}
+
+// Runs every configuration on a workload; returns the number of failed
+// runs, and adds the runs made to runs
+static int64_t stressWorkload(const stressOptions_t &options, const workload_t &load, \
+  uint64_t seed, int64_t &runs)
+{
+  const char *statusNames[] = { "ok", "WRONG", "NOT CONSERVED", "CRASHED", "HUNG" };
+  const char *tmp = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  std::stringstream base;
+  base << tmp << "/eftStress-" << getpid() << "-" << load.name << "-" << seed;
+  std::string input = base.str(), output = base.str() + ".out";
+  std::string withheld = base.str() + ".withheld";
+  if(writeWorkload(load, input) == false){
+    print_error("eftStress: failed to write " << input);
+    return 1;
+  }
+
+  int64_t failures = 0;
+  bool withheldUsed = false;
+  for(size_t c = 0; c < sizeof(stressConfigs) / sizeof(stressConfigs[0]); c++)
+  {
+    const stressConfig_t &config = stressConfigs[c];
+    if(config.workload != NULL && load.name != config.workload){
+      continue;
+    }
+    const std::string &lastInput = config.withholdOpens ? withheld : input;
+    workload_t reduced;
+    if(config.withholdOpens == true){
+      if(writeWorkload(load, withheld, true) == false){
+        print_error("eftStress: failed to write " << withheld);
+        return failures + 1;
+      }
+      withheldUsed = true;
+      reduced = withoutOpens(load);
+    }
+    std::stringstream row;
+    row << std::left << std::setw(10) << load.name << std::setw(18) << config.name \
+      << std::right;
+    bool configFailed = false;
+    for(size_t w = 0; w < options.workers.size(); w++){
+      int64_t workers = config.sequential ? 1 : options.workers[w];
+      int64_t elapsedNs = 0;
+      unlink(output.c_str());
+      int64_t status = (config.partitions > 1) ? \
+        runPartitions(options, input, lastInput, workers, config, output, &elapsedNs) : \
+        runProgram(options, input, workers, config.arguments, output, &elapsedNs);
+      if(status == RUN_OK){
+        status = checkOutput(config.withholdOpens ? reduced : load, output);
+      }
+      ++runs;
+      row << std::setw(5) << workers << ":" << std::fixed << std::setprecision(1) \
+        << std::setw(8) << elapsedNs / 1e6 << "ms";
+      if(status != RUN_OK){
+        row << " " << statusNames[status];
+        configFailed = true;
+        ++failures;
+      }
+      if(config.sequential){
+        break;
+      }
+    }
+    print_output(row.str());
+    if(configFailed == true){
+      print_output("  input kept: " << input << " (" << options.program << " " << input \
+        << " <workers> " << config.arguments << ")");
+      if(config.partitions > 1){
+        print_output("  (run as " << config.partitions << " instances with --partition" \
+          << (config.withholdOpens ? ", the last one on " + withheld : std::string()) << ")");
+      }
+    }
+  }
+  unlink(output.c_str());
+  if(failures == 0 && options.keep == false){
+    unlink(input.c_str());
+    if(withheldUsed == true){
+      unlink(withheld.c_str());
+    }
+  }
+  return failures;
+}
+
+static void printUsage()
+{
+  print_output("USAGE:");
+  print_output("\t./eftStress [options]");
+  print_output("OPTIONS:");
+  print_output("\t--program <path>    transfProg binary to test (default ./transfProg)");
+  print_output("\t--accounts <n>      accounts per workload (default 1000)");
+  print_output("\t--transfers <n>     transfers per workload (default 100000)");
+  print_output("\t--workers <list>    worker counts, e.g. 1,2,4,8 (the default)");
+  print_output("\t--rounds <n>        rounds of new workloads (default 1)");
+  print_output("\t--seed <n>          seed of the first round (default 42)");
+  print_output("\t--timeout <sec>     a run taking longer is a hang (default 60)");
+  print_output("\t--only <workload>   random, one-pair, chain, cycle, hot, sparse, split, grow");
+  print_output("\t                    or mixed");
+  print_output("\t--keep              keep the generated inputs");
+}
+
+
+// ------------------------ main() ------------------------------
+int main(int argc, char *argv[])
+{
+  stressOptions_t options = { "./transfProg", 1000, 100000, std::vector<int64_t>(), \
+    42, 1, 60, NULL, false };
+  static struct option longOptions[] = {
+    { "program",   required_argument, NULL, 'p' },
+    { "accounts",  required_argument, NULL, 'a' },
+    { "transfers", required_argument, NULL, 't' },
+    { "workers",   required_argument, NULL, 'w' },
+    { "rounds",    required_argument, NULL, 'r' },
+    { "seed",      required_argument, NULL, 's' },
+    { "timeout",   required_argument, NULL, 'T' },
+    { "only",      required_argument, NULL, 'o' },
+    { "keep",      no_argument,       NULL, 'k' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt = 0;
+  while((opt = getopt_long(argc, argv, "p:a:t:w:r:s:T:o:k", longOptions, NULL)) != -1)
+  {
+    switch(opt){
+      case 'p': options.program = optarg; break;
+      case 'a': options.accounts = atoll(optarg); break;
+      case 't': options.transfers = atoll(optarg); break;
+      case 'w': {
+        std::stringstream list(optarg);
+        for(std::string item; std::getline(list, item, ','); ){
+          options.workers.push_back(atoll(item.c_str()));
+        }
+        break;
+      }
+      case 'r': options.rounds = atoll(optarg); break;
+      case 's': options.seed = strtoull(optarg, NULL, 10); break;
+      case 'T': options.timeout = atoll(optarg); break;
+      case 'o': options.only = optarg; break;
+      case 'k': options.keep = true; break;
+      default:
+        printUsage();
+        return 0;
+    }
+  }
+  if(options.workers.empty()){
+    options.workers = { 1, 2, 4, 8 };
+  }
+  bool validWorkers = true;
+  for(size_t i = 0; i < options.workers.size(); i++){
+    validWorkers = validWorkers && options.workers[i] >= 1 && options.workers[i] <= MAX_WORKERS;
+  }
+  if(optind != argc || validWorkers == false || options.transfers < 1 || \
+     options.rounds < 1 || options.timeout < 1 || access(options.program, X_OK) != 0){
+    printUsage();
+    return 0;
+  }
+
+  const char *workloads[] = { "random", "one-pair", "chain", "cycle", "hot", "sparse", "split", \
+    "grow", "mixed" };
+  print_output("eftStress: " << options.program << " , " << options.accounts \
+    << " accounts x " << options.transfers << " transfers , " << options.rounds \
+    << " round(s) from seed " << options.seed << " , " << sysconf(_SC_NPROCESSORS_ONLN) \
+    << " online cpu(s)");
+  int64_t failures = 0, runs = 0;
+  for(int64_t round = 0; round < options.rounds; round++){
+    uint64_t seed = options.seed + round;
+    print_output("");
+    print_output("== round " << round + 1 << " , seed " << seed << " (workers:ms) ==");
+    for(size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++){
+      if(options.only != NULL && strcmp(options.only, workloads[i]) != 0){
+        continue;
+      }
+      std::mt19937_64 generator(seed * 131 + i);
+      workload_t load = makeWorkload(workloads[i], options, generator);
+      failures += stressWorkload(options, load, seed, runs);
+    }
+  }
+  print_output("");
+  print_output((failures == 0 ? "PASS" : "FAIL") << ": " << failures << " failed run(s) of " \
+    << runs);
+  return (failures == 0) ? 0 : 1;
+}
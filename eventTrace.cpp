@@ -0,0 +1,126 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T23:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: eventTrace.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T23:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <cstdio>
+#include <algorithm>
+#include <sys/mman.h>
+
+#include "debugMacros.hpp"
+#include "sharedMemory.hpp"
+#include "eventTrace.hpp"
+
+// Std namespace
+using namespace std;
+
+// ------------------------ Class: traceBuffer ------------------------------
+
+// Maps the rings, each with its share of TRACE_BUFFER_EVENTS
+bool traceBuffer :: init(int64_t producers, int64_t workers)
+{
+  int64_t rings = producers + workers;
+  this->producers = producers;
+  int64_t capacity = std::min<int64_t>(TRACE_RING_MAX_EVENTS, \
+    std::max<int64_t>(TRACE_RING_MIN_EVENTS, TRACE_BUFFER_EVENTS / rings));
+  this->rings = rings;
+  this->ringBytes = (sizeof(traceRing_t) + capacity * sizeof(traceEvent_t) + 63) & ~(size_t) 63;
+  this->bytes = this->ringBytes * rings;
+  this->memory = mapSharedMemory(&this->bytes, false);
+  if(this->memory == NULL){
+    return false;
+  }
+  for(int64_t i = 0; i < rings; i++){
+    traceRing_t *ring = this->ring(i);
+    ring->written = 0;
+    ring->capacity = capacity;
+    ring->run.kind = TRACE_NONE;
+  }
+  return true;
+}
+
+// Unmaps the rings
+void traceBuffer :: destroy()
+{
+  if(this->memory != NULL){
+    munmap(this->memory, this->bytes);
+    this->memory = NULL;
+  }
+}
+
+// Ring of producer index, or of worker (index - producers)
+traceRing_t* traceBuffer :: ring(int64_t index)
+{
+  return (traceRing_t *) ((char *) this->memory + this->ringBytes * index);
+}
+
+// Events overwritten before they could be written out
+int64_t traceBuffer :: getDropped()
+{
+  int64_t dropped = 0;
+  for(int64_t i = 0; i < this->rings; i++){
+    dropped += std::max<int64_t>(0, this->ring(i)->written - this->ring(i)->capacity);
+  }
+  return dropped;
+}
+
+// Writes every ring as a thread of process pid: complete ("X") events in
+// microseconds from originNs, with the lines or transfers they cover
+int64_t traceBuffer :: writeChromeTrace(const char *path, int64_t originNs, int64_t pid)
+{
+  const char *names[TRACE_KINDS] = { "none", "parse", "push blocked", "pop wait", \
+    "lock wait", "apply", "merge", "turn wait" };
+  const char *counts[TRACE_KINDS] = { "", "lines", "", "", "", "transfers", "accounts", "" };
+  FILE *file = fopen(path, "w");
+  if(file == NULL){
+    return -1;
+  }
+  int64_t events = 0;
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":0," \
+    "\"args\":{\"name\":\"transfProg\"}}", (long long) pid);
+  for(int64_t i = 0; i < this->rings; i++)
+  {
+    traceRing_t *ring = this->ring(i);
+    // (a worker that crashed may have left its last run open)
+    traceFlush(ring);
+    if(i == 0){
+      fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":0," \
+        "\"args\":{\"name\":\"parser\"}}", (long long) pid);
+    }
+    else {
+      bool producer = (i < this->producers);
+      fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":%lld," \
+        "\"args\":{\"name\":\"%s %lld\"}}", (long long) pid, (long long) i, \
+        producer ? "producer" : "worker", (long long) (producer ? i : i - this->producers));
+    }
+    // Oldest first
+    int64_t first = std::max<int64_t>(0, ring->written - ring->capacity);
+    for(int64_t n = first; n < ring->written; n++){
+      const traceEvent_t &event = traceEvents(ring)[n % ring->capacity];
+      int64_t kind = (event.kind > TRACE_NONE && event.kind < TRACE_KINDS) ? \
+        event.kind : TRACE_NONE;
+      fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%lld,\"tid\":%lld," \
+        "\"ts\":%.3f,\"dur\":%.3f", names[kind], (long long) pid, (long long) i, \
+        (event.startNs - originNs) / 1e3, event.durationNs / 1e3);
+      if(counts[kind][0] != '\0'){
+        fprintf(file, ",\"args\":{\"%s\":%d}", counts[kind], event.count);
+      }
+      fprintf(file, "}");
+      ++events;
+    }
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":%lld}}\n", \
+    (long long) this->getDropped());
+  if(fclose(file) != 0){
+    return -1;
+  }
+  return events;
+}
@@ -0,0 +1,144 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T23:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: eventTrace.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T23:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __EVENT_TRACE__
+#define __EVENT_TRACE__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Events kept by all the rings together; each ring gets its share, within
+// [TRACE_RING_MIN_EVENTS, TRACE_RING_MAX_EVENTS] (pages are only touched as
+// the rings fill up)
+#define   TRACE_BUFFER_EVENTS     (1 << 21)
+#define   TRACE_RING_MIN_EVENTS   4096
+#define   TRACE_RING_MAX_EVENTS   (1 << 17)
+// Waits shorter than this are not recorded
+#define   TRACE_MIN_WAIT_NS       2000
+// A run of parse or apply steps is recorded as one event, up to this many
+// steps, or until a gap longer than TRACE_MIN_WAIT_NS between two of them
+#define   TRACE_RUN_STEPS         64
+
+// What a process was doing
+enum traceEventKind {
+  TRACE_NONE = 0,
+  TRACE_PARSE = 1,                          // parser: lines read and dispatched
+  TRACE_PUSH_BLOCKED = 2,                   // parser: waiting for room in a queue
+  TRACE_POP_WAIT = 3,                       // worker: waiting for a request
+  TRACE_LOCK_WAIT = 4,                      // worker: waiting for an account lock
+  TRACE_APPLY = 5,                          // worker: transfers applied
+  TRACE_MERGE = 6,                          // worker: deltas merged (--reduce)
+  TRACE_TURN_WAIT = 7,                      // worker: waiting for its turn (--ordered)
+  TRACE_KINDS = 8
+};
+
+// -- Typedefs --
+typedef struct traceEvent traceEvent_t;
+typedef struct traceRing traceRing_t;
+typedef class traceBuffer traceBuffer_t;
+
+// -- Structures --
+// A span of time spent on one thing
+struct traceEvent {
+  int64_t startNs;                          // monotonicNs()
+  int64_t durationNs;
+  int32_t kind;                             // traceEventKind
+  int32_t count;                            // lines / transfers it covers
+};
+
+// Events of one process (or producer thread), in shared memory; the oldest
+// are overwritten when it is full. Only its owner writes it, and it is read
+// once the owner is gone. The events follow the header.
+struct traceRing {
+  int64_t written;                          // events ever recorded
+  int64_t capacity;
+  traceEvent_t run;                         // run being extended (kind TRACE_NONE: none)
+};
+
+inline traceEvent_t* traceEvents(traceRing_t *ring)
+{
+  return (traceEvent_t *) (ring + 1);
+}
+
+// Appends an event to the ring
+inline void traceAppend(traceRing_t *ring, const traceEvent_t &event)
+{
+  traceEvents(ring)[ring->written % ring->capacity] = event;
+  ++ring->written;
+}
+
+// Records the run being extended, if any
+inline void traceFlush(traceRing_t *ring)
+{
+  if(ring->run.kind != TRACE_NONE){
+    traceAppend(ring, ring->run);
+    ring->run.kind = TRACE_NONE;
+  }
+}
+
+// Records a span (after the run before it)
+inline void traceSpan(traceRing_t *ring, int64_t kind, int64_t startNs, int64_t endNs, \
+  int64_t count = 1)
+{
+  traceFlush(ring);
+  traceEvent_t event = { startNs, endNs - startNs, (int32_t) kind, (int32_t) count };
+  traceAppend(ring, event);
+}
+
+// Records a wait, if it was long enough to matter
+inline void traceWait(traceRing_t *ring, int64_t kind, int64_t startNs, int64_t endNs)
+{
+  if(endNs - startNs >= TRACE_MIN_WAIT_NS){
+    traceSpan(ring, kind, startNs, endNs);
+  }
+}
+
+// Adds a step (a line parsed, a transfer applied) to the run of its kind
+inline void traceStep(traceRing_t *ring, int64_t kind, int64_t startNs, int64_t endNs, \
+  int64_t count = 1)
+{
+  traceEvent_t *run = &ring->run;
+  if(run->kind != kind || run->count >= TRACE_RUN_STEPS || \
+     startNs - (run->startNs + run->durationNs) > TRACE_MIN_WAIT_NS){
+    traceFlush(ring);
+    run->startNs = startNs;
+    run->count = 0;
+    run->kind = kind;
+  }
+  run->durationNs = endNs - run->startNs;
+  run->count += count;
+}
+
+// -- Classes --
+// The rings of the producers (the parser is producer 0) and then the
+// workers, in one shared mapping made before the workers are forked
+class traceBuffer
+{
+private:
+  void *memory;
+  size_t bytes;
+  int64_t producers;
+  int64_t rings;
+  size_t ringBytes;                         // stride of the rings
+
+public:
+  bool init(int64_t producers, int64_t workers);  // maps the rings (false if that failed)
+  void destroy();
+  traceRing_t* ring(int64_t index);         // ring of a producer (0 ..), then a worker
+  int64_t getDropped();                     // events overwritten in all the rings
+  // Writes the events as a Chrome trace-event JSON file (times from originNs);
+  // returns the number of events written, or -1
+  int64_t writeChromeTrace(const char *path, int64_t originNs, int64_t pid);
+};
+
+#endif
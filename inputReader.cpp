@@ -0,0 +1,211 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T18:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: inputReader.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T18:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <cerrno>
+#include <cstring>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "debugMacros.hpp"
+#include "inputReader.hpp"
+
+// Std namespace
+using namespace std;
+
+
+// ------------------------ Class: inputReader ------------------------------
+
+// Opens the input and starts the reader thread
+int64_t inputReader :: open(const char *fileName)
+{
+  this->ownsFd = (strcmp(fileName, "-") != 0);
+  this->fd = this->ownsFd ? ::open(fileName, O_RDONLY) : STDIN_FILENO;
+  if(this->fd < 0){
+    dbg_trace("Failed to open the file: " << fileName);
+    return FAIL;
+  }
+  // Tell the kernel to read ahead
+  posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  for(int i = 0; i < READER_BUFFERS; i++){
+    this->ring[i].data = (char *) malloc(READER_BUFFER_SIZE);
+    this->ring[i].length = 0;
+    this->ring[i].full = false;
+  }
+  this->stop = false;
+  this->parseIndex = -1;
+  this->atEnd = false;
+  this->cursor = this->end = NULL;
+  this->carry.clear();
+  this->carryReturned = false;
+
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->filled, NULL);
+  pthread_cond_init(&this->emptied, NULL);
+  if(pthread_create(&this->thread, NULL, readerThread, this) != 0){
+    print_output("Failed to start the input reader thread!");
+    exit(1);
+  }
+  return SUCCESS;
+}
+
+// Reader thread: fills the buffers of the ring in order. A buffer is handed
+// over once it is full, or as soon as a read() comes back short (a pipe with
+// nothing more buffered), so a slow producer doesn't hold up the parser.
+void* inputReader :: readerThread(void *reader)
+{
+  inputReader_t *self = (inputReader_t *) reader;
+  for(int64_t index = 0; ; index = (index + 1) % READER_BUFFERS)
+  {
+    readerBuffer_t *buffer = &self->ring[index];
+    pthread_mutex_lock(&self->mutex);
+      while(buffer->full == true && self->stop == false){
+        pthread_cond_wait(&self->emptied, &self->mutex);
+      }
+      bool stopping = self->stop;
+    pthread_mutex_unlock(&self->mutex);
+    if(stopping == true){
+      break;
+    }
+
+    int64_t length = 0;
+    while(length < READER_BUFFER_SIZE){
+      ssize_t bytes = read(self->fd, buffer->data + length, READER_BUFFER_SIZE - length);
+      if(bytes < 0 && errno == EINTR){
+        continue;
+      }
+      if(bytes < 0){
+        print_error("WARNING: Failed to read the input: " << strerror(errno));
+        length = (length > 0) ? length : -1;
+        break;
+      }
+      length += bytes;
+      if(bytes == 0 || bytes < READER_BUFFER_SIZE - (length - bytes)){
+        break;
+      }
+    }
+
+    pthread_mutex_lock(&self->mutex);
+      buffer->length = length;
+      buffer->full = true;
+      pthread_cond_signal(&self->filled);
+    pthread_mutex_unlock(&self->mutex);
+    // An empty (or failed) buffer marks the end of the input
+    if(length <= 0){
+      break;
+    }
+  }
+  return NULL;
+}
+
+// Hands the parsed buffer back to the reader and waits for the next one;
+// returns false at the end of the input
+bool inputReader :: nextBuffer()
+{
+  if(this->atEnd == true){
+    return false;
+  }
+  pthread_mutex_lock(&this->mutex);
+    if(this->parseIndex >= 0){
+      this->ring[this->parseIndex].full = false;
+      pthread_cond_signal(&this->emptied);
+    }
+    this->parseIndex = (this->parseIndex + 1) % READER_BUFFERS;
+    readerBuffer_t *buffer = &this->ring[this->parseIndex];
+    while(buffer->full == false){
+      pthread_cond_wait(&this->filled, &this->mutex);
+    }
+    int64_t length = buffer->length;
+  pthread_mutex_unlock(&this->mutex);
+
+  if(length <= 0){
+    this->atEnd = true;
+    return false;
+  }
+  this->cursor = buffer->data;
+  this->end = buffer->data + length;
+  return true;
+}
+
+// Next line of the input
+bool inputReader :: getLine(const char **line, size_t *length)
+{
+  size_t lineLength = 0;
+  if(length == NULL){
+    length = &lineLength;
+  }
+  if(this->carryReturned == true){
+    this->carry.clear();
+    this->carryReturned = false;
+  }
+  while(1)
+  {
+    if(this->cursor < this->end)
+    {
+      char *newline = (char *) memchr(this->cursor, '\n', this->end - this->cursor);
+      if(newline == NULL){
+        // The line goes on in the next buffer
+        this->carry.append(this->cursor, this->end - this->cursor);
+        this->cursor = this->end;
+      }
+      else if(this->carry.empty()){
+        // The whole line is in this buffer; terminate it in place
+        *newline = '\0';
+        *line = this->cursor;
+        *length = newline - this->cursor;
+        this->cursor = newline + 1;
+        return true;
+      }
+      else {
+        this->carry.append(this->cursor, newline - this->cursor);
+        this->cursor = newline + 1;
+        *line = this->carry.c_str();
+        *length = this->carry.size();
+        this->carryReturned = true;
+        return true;
+      }
+    }
+    if(this->nextBuffer() == false){
+      // Last line without a newline
+      if(this->carry.empty() == false){
+        *line = this->carry.c_str();
+        *length = this->carry.size();
+        this->carryReturned = true;
+        return true;
+      }
+      return false;
+    }
+  }
+}
+
+// Stops the reader thread (it may still be waiting for a buffer) and closes
+// the input
+void inputReader :: close()
+{
+  pthread_mutex_lock(&this->mutex);
+    this->stop = true;
+    pthread_cond_broadcast(&this->emptied);
+  pthread_mutex_unlock(&this->mutex);
+  pthread_join(this->thread, NULL);
+
+  pthread_cond_destroy(&this->emptied);
+  pthread_cond_destroy(&this->filled);
+  pthread_mutex_destroy(&this->mutex);
+  for(int i = 0; i < READER_BUFFERS; i++){
+    free(this->ring[i].data);
+    this->ring[i].data = NULL;
+  }
+  if(this->ownsFd == true){
+    ::close(this->fd);
+  }
+}
@@ -0,0 +1,72 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T18:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: inputReader.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T18:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __INPUT_READER__
+#define __INPUT_READER__
+
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+
+// Buffers in the ring between the reader thread and the parser
+#define   READER_BUFFERS          4
+// Size of each of them
+#define   READER_BUFFER_SIZE      (1024 * 1024)
+
+// -- Typedefs --
+typedef struct readerBuffer readerBuffer_t;
+typedef class inputReader inputReader_t;
+
+// A buffer of the ring; owned by the reader thread while it is empty and by
+// the parser while it is full
+struct readerBuffer {
+  char *data;
+  int64_t length;                           // bytes read (0: end of input, -1: error)
+  bool full;
+};
+
+// -- Class --
+// Reads the input on its own thread, read() after read() into the buffers of
+// a small ring, while the parser takes lines out of the buffers filled before.
+// Works the same on files, pipes and FIFOs ("-" reads stdin).
+class inputReader
+{
+private:
+  int fd;
+  bool ownsFd;                              // false for stdin
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t filled;                    // a buffer was filled
+  pthread_cond_t emptied;                   // a buffer was handed back
+  readerBuffer_t ring[READER_BUFFERS];
+  bool stop;                                // the parser is closing early
+  // parser side
+  int64_t parseIndex;                       // buffer being parsed (-1: none yet)
+  bool atEnd;                               // end of input (or error) reached
+  char *cursor;                             // unparsed part of the buffer
+  char *end;
+  std::string carry;                        // line split across two buffers
+  bool carryReturned;
+
+  static void* readerThread(void *reader);  // fills the ring
+  bool nextBuffer();                        // hands back a buffer, waits for the next
+
+public:
+  int64_t open(const char *fileName);       // starts the reader thread
+  bool getLine(const char **line, \
+    size_t *length = NULL);                 // next line (NUL terminated, without
+                                            // the newline), valid until the next call
+  void close();                             // stops the reader thread
+};
+
+#endif
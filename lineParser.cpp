@@ -0,0 +1,287 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T19:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: lineParser.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T19:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <cstring>
+#include <immintrin.h>
+
+#include "debugMacros.hpp"
+#include "lineParser.hpp"
+
+// Std namespace
+using namespace std;
+
+// Longest digit run decodeDigits() takes
+#define   SIMD_MAX_DIGITS         16
+
+typedef int64_t (*lineParserFunc_t)(const char *line, size_t length, bool skipWord, \
+  int64_t *values, int64_t count);
+
+
+// -- Scalar parser (the reference; every line the others can't take) --
+
+static inline bool isSpace(char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// One ">> int64_t" extraction
+static bool extractInteger(const char *&text, const char *end, int64_t *value)
+{
+  while(text < end && isSpace(*text)){
+    ++text;
+  }
+  if(text == end){
+    return false;                           // line ended: value left alone
+  }
+  bool negative = false;
+  if(*text == '+' || *text == '-'){
+    negative = (*text == '-');
+    ++text;
+  }
+  uint64_t limit = negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX;
+  uint64_t number = 0;
+  bool digits = false, overflow = false;
+  for(; text < end && *text >= '0' && *text <= '9'; ++text){
+    uint64_t digit = *text - '0';
+    digits = true;
+    if(number > (limit - digit) / 10){
+      overflow = true;
+    }
+    else {
+      number = number * 10 + digit;
+    }
+  }
+  if(digits == false){
+    *value = 0;
+    return false;
+  }
+  if(overflow == true){
+    *value = negative ? INT64_MIN : INT64_MAX;
+    return false;
+  }
+  *value = negative ? (int64_t) (0 - number) : (int64_t) number;
+  return true;
+}
+
+static int64_t parseScalar(const char *line, size_t length, bool skipWord, \
+  int64_t *values, int64_t count)
+{
+  // (a stringstream of the line ends at a NUL)
+  const char *text = line;
+  const char *end = line + strnlen(line, length);
+  if(skipWord == true){
+    while(text < end && isSpace(*text)){
+      ++text;
+    }
+    if(text == end){
+      return 0;
+    }
+    while(text < end && isSpace(*text) == false){
+      ++text;
+    }
+  }
+  int64_t parsed = 0;
+  while(parsed < count && extractInteger(text, end, &values[parsed])){
+    ++parsed;
+  }
+  return parsed;
+}
+
+
+// -- Vectorized parsers --
+// The line is classified 16 or 32 bytes at a time into digit and blank
+// (' ', '\t') bitmasks, and the digit runs are found with bit operations and
+// decoded 16 digits at a time. Lines with anything else in them (signs, other
+// whitespace, over 16 digits, ...) are left to the scalar parser, so the
+// results are always the same.
+// The loads may go past the end of the line (the bytes there are masked
+// off), which is only done when they stay within the line's memory page;
+// otherwise the line is copied into a local buffer first.
+
+// Bytes the vector loads may touch from the start of the line
+#define   SIMD_READ_SPAN          (SIMD_LINE_LENGTH + 16)
+#define   PAGE_SIZE_MIN           4096
+
+// The line, or a copy of it when reading past its end could fault
+static inline const char* loadableLine(const char *line, size_t length, char *copy)
+{
+  if(((uintptr_t) line & (PAGE_SIZE_MIN - 1)) <= PAGE_SIZE_MIN - SIMD_READ_SPAN){
+    return line;
+  }
+  memcpy(copy, line, length);
+  return copy;
+}
+
+// Decodes the n (1..16) digits at text
+__attribute__((target("sse4.2")))
+static inline uint64_t decodeDigits(const char *text, int64_t n)
+{
+  __m128i digits = _mm_sub_epi8(_mm_loadu_si128((const __m128i *) text), \
+    _mm_set1_epi8('0'));
+  // Right-align the n digits (indexes with the high bit set give zeros)
+  __m128i shuffle = _mm_add_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, \
+    8, 9, 10, 11, 12, 13, 14, 15), _mm_set1_epi8((char) (n - 16)));
+  digits = _mm_shuffle_epi8(digits, shuffle);
+  // 16 x 1 digit -> 8 x 2 digits -> 4 x 4 digits -> 2 x 8 digits
+  __m128i pairs = _mm_maddubs_epi16(digits, _mm_setr_epi8(10, 1, 10, 1, 10, 1, \
+    10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+  __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  __m128i packed = _mm_packus_epi32(quads, quads);
+  __m128i octets = _mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 10000, 1, \
+    10000, 1, 10000, 1));
+  uint64_t high = (uint32_t) _mm_cvtsi128_si32(octets);
+  uint64_t low = (uint32_t) _mm_extract_epi32(octets, 1);
+  return high * 100000000ULL + low;
+}
+
+// Fields from the digit and blank masks of the first `length` bytes of text;
+// returns -1 when the line has to go to the scalar parser
+__attribute__((target("sse4.2")))
+static inline int64_t parseMasks(const char *text, size_t length, uint32_t digitMask, \
+  uint32_t blankMask, bool skipWord, int64_t *values, int64_t count)
+{
+  uint32_t valid = (length == 32) ? ~0u : ((1u << length) - 1);
+  uint32_t region = valid;
+  digitMask &= valid;
+  blankMask &= valid;
+  if(skipWord == true){
+    // The word runs up to the first blank; it must start the line
+    if(length == 0 || (blankMask & 1) != 0){
+      return -1;
+    }
+    uint32_t wordEnd = __builtin_ctz(blankMask | ~valid | 0x80000000u);
+    if(blankMask == 0 && length == 32){
+      return -1;
+    }
+    region &= ~((1u << wordEnd) - 1);
+  }
+  uint32_t digits = digitMask & region;
+  if(((digits | blankMask) & region) != region){
+    return -1;
+  }
+  uint32_t starts = digits & ~(digits << 1);
+  uint32_t ends = digits & ~(digits >> 1);
+
+  int64_t decoded[8];
+  int64_t parsed = 0;
+  for(; parsed < count && starts != 0; parsed++){
+    int64_t first = __builtin_ctz(starts);
+    int64_t last = __builtin_ctz(ends);
+    if(last - first + 1 > SIMD_MAX_DIGITS || parsed == 8){
+      return -1;
+    }
+    decoded[parsed] = (int64_t) decodeDigits(text + first, last - first + 1);
+    starts &= starts - 1;
+    ends &= ends - 1;
+  }
+  for(int64_t i = 0; i < parsed; i++){
+    values[i] = decoded[i];
+  }
+  return parsed;
+}
+
+__attribute__((target("sse4.2")))
+static int64_t parseSSE42(const char *line, size_t length, bool skipWord, \
+  int64_t *values, int64_t count)
+{
+  if(length > SIMD_LINE_LENGTH){
+    return parseScalar(line, length, skipWord, values, count);
+  }
+  char copy[64];
+  const char *text = loadableLine(line, length, copy);
+  __m128i zero = _mm_set1_epi8('0' - 1), nine = _mm_set1_epi8('9' + 1);
+  __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+  uint32_t digitMask = 0, blankMask = 0;
+  for(int half = 0; half < 2; half++){
+    __m128i bytes = _mm_loadu_si128((const __m128i *) (text + 16 * half));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, zero), _mm_cmplt_epi8(bytes, nine));
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(bytes, tab));
+    digitMask |= (uint32_t) _mm_movemask_epi8(digit) << (16 * half);
+    blankMask |= (uint32_t) _mm_movemask_epi8(blank) << (16 * half);
+  }
+  int64_t parsed = parseMasks(text, length, digitMask, blankMask, skipWord, values, count);
+  if(parsed < 0){
+    return parseScalar(line, length, skipWord, values, count);
+  }
+  return parsed;
+}
+
+__attribute__((target("avx2")))
+static int64_t parseAVX2(const char *line, size_t length, bool skipWord, \
+  int64_t *values, int64_t count)
+{
+  if(length > SIMD_LINE_LENGTH){
+    return parseScalar(line, length, skipWord, values, count);
+  }
+  char copy[64];
+  const char *text = loadableLine(line, length, copy);
+  __m256i bytes = _mm256_loadu_si256((const __m256i *) text);
+  __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('0' - 1)), \
+    _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), bytes));
+  __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')), \
+    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')));
+  uint32_t digitMask = (uint32_t) _mm256_movemask_epi8(digit);
+  uint32_t blankMask = (uint32_t) _mm256_movemask_epi8(blank);
+  int64_t parsed = parseMasks(text, length, digitMask, blankMask, skipWord, values, count);
+  if(parsed < 0){
+    return parseScalar(line, length, skipWord, values, count);
+  }
+  return parsed;
+}
+
+
+// -- Dispatch --
+
+static lineParserFunc_t sParseFields = parseScalar;
+
+// Picks the implementation
+int64_t selectLineParser(int64_t requested)
+{
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2");
+  bool sse42 = __builtin_cpu_supports("sse4.2");
+  int64_t parser = PARSER_SCALAR;
+  if(requested == PARSER_AUTO){
+    parser = avx2 ? PARSER_AVX2 : (sse42 ? PARSER_SSE42 : PARSER_SCALAR);
+  }
+  else if(requested == PARSER_AVX2){
+    parser = avx2 ? PARSER_AVX2 : (sse42 ? PARSER_SSE42 : PARSER_SCALAR);
+  }
+  else if(requested == PARSER_SSE42){
+    parser = sse42 ? PARSER_SSE42 : PARSER_SCALAR;
+  }
+  if(requested != PARSER_AUTO && parser != requested){
+    print_error("WARNING: " << lineParserName(requested) << " not supported; using " \
+      << lineParserName(parser));
+  }
+
+  switch(parser){
+    case PARSER_AVX2: sParseFields = parseAVX2; break;
+    case PARSER_SSE42: sParseFields = parseSSE42; break;
+    default: sParseFields = parseScalar; break;
+  }
+  return parser;
+}
+
+// Name of a lineParserType
+const char* lineParserName(int64_t parser)
+{
+  const char *names[] = { "auto", "scalar", "sse4.2", "avx2" };
+  return (parser >= PARSER_AUTO && parser <= PARSER_AVX2) ? names[parser] : "unknown";
+}
+
+// Parses the numeric fields of a line
+int64_t parseLineFields(const char *line, size_t length, bool skipWord, \
+  int64_t *values, int64_t count)
+{
+  return sParseFields(line, length, skipWord, values, count);
+}
@@ -0,0 +1,47 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T19:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: lineParser.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T19:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __LINE_PARSER__
+#define __LINE_PARSER__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest line the vectorized parsers take; longer ones go to the scalar one
+#define   SIMD_LINE_LENGTH        32
+
+// Implementations of parseLineFields()
+enum lineParserType {
+  PARSER_AUTO = 0,                          // the widest one the cpu supports
+  PARSER_SCALAR = 1,
+  PARSER_SSE42 = 2,                         // 16 bytes at a time
+  PARSER_AVX2 = 3                           // 32 bytes at a time
+};
+
+// Picks the implementation (falling back to what the cpu supports);
+// returns the lineParserType in use. The widest is not always the fastest
+// on short lines; eftBench compares them on the machine at hand.
+int64_t selectLineParser(int64_t requested);
+// Name of a lineParserType
+const char* lineParserName(int64_t parser);
+
+// Parses the numeric fields of a line (after a leading word when skipWord
+// is set) into values[0..count) exactly like "stream >> word >> values[0] >>
+// ..." on a stringstream of the line would: an extraction that finds the
+// line ended leaves its value alone, one that finds no number stores 0 (or
+// the clamped value on overflow), and either way the ones after it are not
+// done. Returns the number of values extracted successfully.
+int64_t parseLineFields(const char *line, size_t length, bool skipWord, \
+  int64_t *values, int64_t count);
+
+#endif
@@ -11,134 +11,127 @@
 
 
 #include <iostream>
+#include <sstream>
 #include <memory>
 #include <pthread.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <cstring>
+#include <vector>
+#include <algorithm>
 #include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
 
 #include "debugMacros.hpp"
 #include "transfProg.hpp"
+#include "transferEngine.hpp"
+#include "crashRecovery.hpp"
 
 using namespace std;
 
 
-// Worker function (EFT requests processing in a forked child process)
-void EFTWorker(processData_t *data)
+// Runs a worker in a freshly forked child; never returns
+static void runWorker(processData_t *workerData, EFTWorkerFunc_t EFTWorker, \
+  int64_t NumberOfProcesses, const transfOptions_t &options)
 {
-  processData_t *workerData = data;
-  EFTRequest_t requestToProcess;
-
+  // Execute worker
   dbg_trace("PID: " << getpid() << " , " << "PPID: " << getppid() << " , " \
-  << "After Spawning: processData[" << workerData->processID << "]: " << workerData << " , "\
-  << "[Processe-ID: " << workerData->processID << "]: "\
-  << "Queue-ID: " << workerData->EFTRequests.getWorkerID());
+  << "After Spawning: processData[" << workerData->processID << "]: " << workerData);
+  EFTWorker(workerData, NumberOfProcesses, options.batchSize);
 
-  // workerData->accountPool->dbgPrintAccountPool();
+  // unmap the memory here
+  munmap(workerData->accountPool, sizeof(bankAccountPool_t));
+  munmap(workerData, sizeof(processData_t));
 
-  while(1)
+  // exit from child
+  exit(EXIT_SUCCESS);
+}
+
+// Forks the workers [first, last) from the calling process
+static int64_t forkWorkers(processData_t **processPool, int64_t first, int64_t last, \
+  EFTWorkerFunc_t EFTWorker, int64_t NumberOfProcesses, const transfOptions_t &options)
+{
+  for(int64_t process = first; process < last; process++)
   {
-    // Read data from worker queue/buffer
-    // This has been implemented in an atomic way with the use of
-    // synchronization constructs
-    requestToProcess = workerData->EFTRequests.popRequest();
-
-    int64_t fromBalance = 0, toBalance = 0;
-    int64_t fromAccount = requestToProcess.fromAccount;
-    int64_t toAccount = requestToProcess.toAccount;
-    int64_t transferAmount = requestToProcess.transferAmount;
-
-    // Check if we are done
-    if(fromAccount == -1 || toAccount == -1){
-      break;
+    // Spwan it
+    int64_t status = fork();
+    if(status < 0){
+      print_output("Failed to create process: " << process);
+      return FAIL;
     }
-    /*dbg_trace("[requestToProcess]: "\
-    << "From: " << fromAccount << " , "\
-    << "To: " << toAccount << " , "\
-    << "Transfer: " << transferAmount);*/
-
-    // -- Process the request with "restricted order" of accounts to avoid deadlocks
-    // ========== ENTER Critical Section ==========
-      if(fromAccount < toAccount)
-      { // 1. From, 2. To
-        workerData->accountPool->at(fromAccount)->lock();
-        workerData->accountPool->at(toAccount)->lock();
-      }
-      else
-      { // 1. To, 2. From
-        workerData->accountPool->at(toAccount)->lock();
-        workerData->accountPool->at(fromAccount)->lock();
-      }
-        // -- Get the balance
-        fromBalance = workerData->accountPool->at(fromAccount)->getBalance();
-        toBalance = workerData->accountPool->at(toAccount)->getBalance();
-
-        /*dbg_trace("[beforeProcess]: "\
-        << "From: " << fromBalance << " , "\
-        << "To: " << toBalance);*/
-
-        // -- Update the account with new balance
-        workerData->accountPool->at(fromAccount)->setBalance(fromBalance - transferAmount);
-        workerData->accountPool->at(toAccount)->setBalance(toBalance + transferAmount);
-
-        /*dbg_trace("[AfterProcess]: "\
-        << "From: " << workerData->accountPool->at(fromAccount)->getBalance() << " , "\
-        << "To: " << workerData->accountPool->at(toAccount)->getBalance());*/
-
-      if(fromAccount < toAccount)
-      { // 1. To, 2. From
-        workerData->accountPool->at(toAccount)->unlock();
-        workerData->accountPool->at(fromAccount)->unlock();
-      }
-      else
-      { // 1. From, 2. To
-        workerData->accountPool->at(fromAccount)->unlock();
-        workerData->accountPool->at(toAccount)->unlock();
-      }
-    // ========= EXIT Critical Section =========
+    else if(status == 0)        // Child process
+    {
+      runWorker(processPool[process], EFTWorker, NumberOfProcesses, options);
+    }
+    processPool[process]->pid = status;
   }
-  dbg_trace("PROCESS: " << workerData->processID << " - " << getpid() << " EXIT!");
-  return;
+  return SUCCESS;
 }
 
-
 // Function to create process data and spawn processes
 int64_t spawnProcesses(processData_t **processDataPool, \
-  bankAccountPool_t *accountPool, int64_t NumberOfProcesses)
+  bankAccountPool_t *accountPool, int64_t NumberOfProcesses, \
+  const transfOptions_t &options)
 {
   processData_t **processPool = processDataPool;
-  bool spawnProcessesStatus = FAIL;
   int64_t process = 0;
+  // Engine instantiation for the requested policies
+  EFTWorkerFunc_t EFTWorker = selectEFTWorker(options);
 
+  // The queues must be ready before anything is pushed; this is cheap
   for(process = 0; process < NumberOfProcesses; process++)
   {
     processPool[process]->processID = process;
     processPool[process]->EFTRequests.init();
     processPool[process]->EFTRequests.setWorkerID(process);
     processPool[process]->accountPool = accountPool;
+    processPool[process]->inflight.state = INFLIGHT_IDLE;
+    processPool[process]->injectCrashAt = (process == options.crashWorker) ? \
+      options.crashTransfer : 0;
+  }
 
-    // Spwan it
-    int64_t status = fork();
-    if(status < 0){
-      print_output("Failed to create process: " << process);
-      exit(1);
+  // Few workers: fork them one by one
+  if(NumberOfProcesses <= SPAWN_FANOUT_THRESHOLD){
+    return forkWorkers(processPool, 0, NumberOfProcesses, EFTWorker, \
+      NumberOfProcesses, options);
+  }
+
+  // Many workers: forking is the expensive part, so helper processes fork
+  // SPAWN_PER_HELPER workers each, in parallel, and exit. We become the
+  // subreaper of the orphaned workers so main() still wait()s for them.
+  if(prctl(PR_SET_CHILD_SUBREAPER, 1) != 0){
+    dbg_trace("PR_SET_CHILD_SUBREAPER failed; forking workers serially");
+    return forkWorkers(processPool, 0, NumberOfProcesses, EFTWorker, \
+      NumberOfProcesses, options);
+  }
+  std::vector<pid_t> helpers;
+  for(process = 0; process < NumberOfProcesses; process += SPAWN_PER_HELPER)
+  {
+    int64_t last = std::min<int64_t>(process + SPAWN_PER_HELPER, NumberOfProcesses);
+    pid_t helper = fork();
+    if(helper < 0){
+      print_output("Failed to create spawning helper for process: " << process);
+      return FAIL;
     }
-    else if(status == 0)        // Child process
+    else if(helper == 0)        // Helper process
     {
-      // Execute worker
-      EFTWorker(processPool[process]);
-
-      // unmap the memory here
-      munmap(processPool[process]->accountPool, sizeof(bankAccountPool_t));
-      munmap(processPool[process], sizeof(processData_t));
-
-      // exit from child
-      exit(EXIT_SUCCESS);
+      int64_t status = forkWorkers(processPool, process, last, EFTWorker, \
+        NumberOfProcesses, options);
+      _exit(status == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
     }
+    helpers.push_back(helper);
   }
-  if(process == NumberOfProcesses){
-    spawnProcessesStatus = SUCCESS;
+  int64_t spawnProcessesStatus = SUCCESS;
+  for(size_t i = 0; i < helpers.size(); i++){
+    int hStatus = 0;
+    if(waitpid(helpers[i], &hStatus, 0) < 0 || !WIFEXITED(hStatus) || \
+       WEXITSTATUS(hStatus) != EXIT_SUCCESS){
+      spawnProcessesStatus = FAIL;
+    }
   }
   return spawnProcessesStatus;
 }
@@ -153,9 +146,13 @@ void askProcessesToExit(processData_t **processData, int64_t NumberOfProcesses,
   int64_t requestCount = 0;
 
   // Sanity checks
-  if(lastAssignedID == -1 || NumberOfProcesses < 0){
+  if(NumberOfProcesses < 1){
     return;
   }
+  // No request was assigned at all; still every process has to exit
+  if(lastAssignedID == -1){
+    assignID = lastAssignedID = NumberOfProcesses - 1;
+  }
 
   do {
       // Calculate worker ID to be assigned
@@ -174,3 +171,91 @@ void askProcessesToExit(processData_t **processData, int64_t NumberOfProcesses,
 
   dbg_trace("Total Processes Requested to Exit: " << requestCount);
 }
+
+
+// A worker died: finish its request, repair its queue and fork a new worker
+// on it. Engines that can't be recovered stop the whole run instead.
+static void respawnWorker(processData_t **processData, int64_t NumberOfProcesses, \
+  int64_t worker, int status, const transfOptions_t &options)
+{
+  processData_t *workerData = processData[worker];
+  std::stringstream cause;
+  if(WIFSIGNALED(status)){
+    cause << "killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+  }
+  else {
+    cause << "exited with status " << WEXITSTATUS(status);
+  }
+  if(crashTolerantEngine(options) == false){
+    print_error("ERROR: worker " << worker << " (pid " << workerData->pid << ") " \
+      << cause.str() << "; --batch, --reduce and --lock spin can't recover from that");
+    for(int64_t i = 0; i < NumberOfProcesses; i++){
+      if(i != worker && processData[i]->pid > 0){
+        kill(processData[i]->pid, SIGKILL);
+      }
+    }
+    removeRunFiles(options);
+    exit(1);
+  }
+
+  int64_t outcome = recoverWorker(processData[0], NumberOfProcesses, worker);
+  const char *outcomes[] = { "nothing left to finish", "rolled its transfer forward", \
+    "applied its popped request", "left its popped request to the new worker" };
+  workerData->injectCrashAt = 0;
+  int64_t deadPID = workerData->pid;
+  pid_t pid = fork();
+  if(pid < 0){
+    print_error("ERROR: failed to respawn worker " << worker);
+    exit(1);
+  }
+  else if(pid == 0)             // Child process
+  {
+    runWorker(workerData, selectEFTWorker(options), NumberOfProcesses, options);
+  }
+  workerData->pid = pid;
+  print_error("WARNING: worker " << worker << " (pid " << deadPID << ") " << cause.str() \
+    << "; " << outcomes[outcome] << ", respawned as pid " << pid);
+}
+
+// Reaps the workers that have exited (with block, waits for one); a worker
+// that crashed is recovered and respawned. Returns the number of workers that
+// exited normally, or -1 when there are no children left to wait for.
+int64_t reapWorkers(processData_t **processData, int64_t NumberOfProcesses, \
+  const transfOptions_t &options, bool block)
+{
+  int64_t exited = 0;
+  while(1)
+  {
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, block ? 0 : WNOHANG);
+    if(pid < 0 && errno == EINTR){
+      continue;
+    }
+    if(pid < 0){
+      return (exited > 0) ? exited : -1;
+    }
+    if(pid == 0){
+      return exited;
+    }
+    int64_t worker = -1;
+    for(int64_t i = 0; i < NumberOfProcesses && worker == -1; i++){
+      if(processData[i]->pid == pid){
+        worker = i;
+      }
+    }
+    if(worker == -1){
+      continue;                 // (a spawning helper)
+    }
+    if(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS){
+      dbg_trace("PROCESS: " << worker << " TERMINATED!");
+      processData[worker]->pid = 0;
+      ++exited;
+    }
+    else {
+      respawnWorker(processData, NumberOfProcesses, worker, status, options);
+    }
+    if(block == true){
+      return exited;
+    }
+  }
+}
@@ -0,0 +1,456 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-20T01:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: partitionLink.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-20T01:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "debugMacros.hpp"
+#include "controlSocket.hpp"
+#include "partitionLink.hpp"
+
+// Std namespace
+using namespace std;
+
+// Messages read from a connection at once
+#define   PARTITION_READ_BATCH          256
+
+// Reads a connection a batch of whole messages at a time
+typedef struct messageReader {
+  int connection;
+  partitionMessage_t messages[PARTITION_READ_BATCH];
+  size_t held;                              // bytes in messages
+  size_t returned;                          // of which were returned last time
+} messageReader_t;
+
+
+// Milliseconds on the monotonic clock
+static int64_t monotonicMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Socket partition i listens on
+static std::string partitionSocketPath(const char *directory, int64_t i)
+{
+  std::stringstream path;
+  path << directory << "/partition-" << i << ".sock";
+  return path.str();
+}
+
+// Writes all the bytes (MSG_NOSIGNAL: a peer that went away is reported,
+// it doesn't kill us)
+static bool writeAll(int connection, const void *data, size_t bytes)
+{
+  const char *next = (const char *) data;
+  while(bytes > 0)
+  {
+    ssize_t written = send(connection, next, bytes, MSG_NOSIGNAL);
+    if(written < 0 && errno == EINTR){
+      continue;
+    }
+    if(written <= 0){
+      return false;
+    }
+    next += written;
+    bytes -= written;
+  }
+  return true;
+}
+
+// Reads the next whole messages (the ones returned before are dropped);
+// returns their count, 0 at the end of the connection or -1 if it broke
+static int64_t readMessages(messageReader_t &reader)
+{
+  char *buffer = (char *) reader.messages;
+  memmove(buffer, buffer + reader.returned, reader.held - reader.returned);
+  reader.held -= reader.returned;
+  reader.returned = 0;
+  while(reader.held < sizeof(partitionMessage_t))
+  {
+    ssize_t bytes = read(reader.connection, buffer + reader.held, \
+      sizeof(reader.messages) - reader.held);
+    if(bytes < 0 && errno == EINTR){
+      continue;
+    }
+    if(bytes <= 0){
+      return (bytes == 0 && reader.held == 0) ? 0 : -1;
+    }
+    reader.held += bytes;
+  }
+  reader.returned = reader.held - reader.held % sizeof(partitionMessage_t);
+  return reader.returned / sizeof(partitionMessage_t);
+}
+
+// Makes the directory of the run's sockets, or checks the one there is
+// ours and private (openControlSocket won't take over a socket another
+// run listens on)
+bool partitionLink :: claimDirectory(const char *directory)
+{
+  struct stat info;
+  if(mkdir(directory, 0700) != 0 && errno != EEXIST){
+    print_error("ERROR: failed to make " << directory << ": " << strerror(errno));
+    return false;
+  }
+  if(lstat(directory, &info) != 0 || S_ISDIR(info.st_mode) == false || \
+     info.st_uid != geteuid() || (info.st_mode & 077) != 0){
+    print_error("ERROR: " << directory << " must be a directory of ours that" \
+      " only we can use (mode 0700)");
+    return false;
+  }
+  return true;
+}
+
+// Connects to every peer (retrying until it listens) and says who we are
+bool partitionLink :: connectPeers(const char *directory)
+{
+  int64_t deadline = monotonicMs() + PARTITION_CONNECT_TIMEOUT_MS;
+  for(int64_t peer = 0; peer < this->partitions; peer++)
+  {
+    if(peer == this->index){
+      continue;
+    }
+    std::string path = partitionSocketPath(directory, peer);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)){
+      print_error("Socket path too long: " << path);
+      return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+    while(1)
+    {
+      int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(connection < 0){
+        return false;
+      }
+      if(connect(connection, (struct sockaddr *) &address, sizeof(address)) == 0){
+        this->outbound[peer] = connection;
+        break;
+      }
+      ::close(connection);
+      if(monotonicMs() > deadline){
+        print_error("ERROR: partition " << peer << " did not come up on " << path);
+        return false;
+      }
+      usleep(10000);
+    }
+    partitionMessage_t hello = { PARTITION_HELLO, this->index, this->partitions, this->token };
+    if(writeAll(this->outbound[peer], &hello, sizeof(hello)) == false){
+      return false;
+    }
+  }
+  return true;
+}
+
+// Takes the connection of every peer
+bool partitionLink :: acceptPeers()
+{
+  int64_t deadline = monotonicMs() + PARTITION_CONNECT_TIMEOUT_MS;
+  for(int64_t accepted = 0; accepted < this->partitions - 1; )
+  {
+    struct pollfd waiting = { this->listener, POLLIN, 0 };
+    int64_t timeout = deadline - monotonicMs();
+    if(timeout <= 0 || poll(&waiting, 1, timeout) == 0){
+      print_error("ERROR: only " << accepted << " of the " << this->partitions - 1 \
+        << " other partition(s) connected to " << this->listenPath);
+      return false;
+    }
+    int connection = accept(this->listener, NULL, NULL);
+    if(connection < 0){
+      continue;
+    }
+    // Only our own user's processes, and no waiting past the deadline for
+    // a hello that doesn't come
+    if(peerIsOurUser(connection) == false){
+      print_error("ERROR: a process of another user connected to " << this->listenPath);
+      ::close(connection);
+      return false;
+    }
+    struct timeval wait = { (time_t) (timeout / 1000), (suseconds_t) ((timeout % 1000) * 1000) };
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+    // Its hello, and nothing after it
+    partitionMessage_t hello;
+    size_t held = 0;
+    while(held < sizeof(hello))
+    {
+      ssize_t bytes = read(connection, (char *) &hello + held, sizeof(hello) - held);
+      if(bytes < 0 && errno == EINTR){
+        continue;
+      }
+      if(bytes <= 0){
+        break;
+      }
+      held += bytes;
+    }
+    int64_t peer = hello.from;
+    if(held < sizeof(hello) || hello.kind != PARTITION_HELLO || \
+       hello.to != this->partitions || peer < 0 || peer >= this->partitions || \
+       peer == this->index || this->inbound[peer] != -1){
+      print_error("ERROR: unexpected connection on " << this->listenPath \
+        << " (not one of the other " << this->partitions - 1 << " partition(s))");
+      ::close(connection);
+      return false;
+    }
+    if(hello.amount != this->token){
+      print_error("ERROR: partition " << peer << " on " << this->listenPath \
+        << " belongs to another run (its input differs)");
+      ::close(connection);
+      return false;
+    }
+    struct timeval forever = { 0, 0 };
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &forever, sizeof(forever));
+    this->inbound[peer] = connection;
+    ++accepted;
+  }
+  return true;
+}
+
+// Applies the credits of a peer and replies to each of them, until it is
+// done sending
+void* partitionLink :: serveCredits(void *arg)
+{
+  std::pair<partitionLink *, int64_t> *threadPeer = (std::pair<partitionLink *, int64_t> *) arg;
+  partitionLink_t *link = threadPeer->first;
+  int64_t peer = threadPeer->second;
+  peerTraffic_t &traffic = link->traffic[peer];
+  messageReader_t *reader = new messageReader_t();
+  reader->connection = link->inbound[peer];
+  std::vector<partitionMessage_t> replies;
+
+  int64_t count = 0;
+  while((count = readMessages(*reader)) > 0)
+  {
+    replies.clear();
+    for(int64_t i = 0; i < count; i++)
+    {
+      partitionMessage_t reply = reader->messages[i];
+      if(reply.kind != PARTITION_CREDIT){
+        continue;
+      }
+      ++traffic.received;
+      traffic.receivedAmount += reply.amount;
+      if(link->onCredit(peer, reply.to, reply.amount) == true){
+        reply.kind = PARTITION_ACK;
+      }
+      else {
+        reply.kind = PARTITION_REFUSED;
+        ++traffic.declined;
+      }
+      replies.push_back(reply);
+    }
+    if(writeAll(reader->connection, replies.data(), \
+       replies.size() * sizeof(partitionMessage_t)) == false){
+      count = -1;
+      break;
+    }
+  }
+  // No more credits from the peer, nor replies to it
+  shutdown(reader->connection, SHUT_WR);
+  delete reader;
+  if(count < 0){
+    print_error("ERROR: lost the connection from partition " << peer);
+    return (void *) 1;
+  }
+  return NULL;
+}
+
+// Takes the replies of a peer to our credits (refunding the refused ones),
+// until it is done replying
+void* partitionLink :: readReplies(void *arg)
+{
+  std::pair<partitionLink *, int64_t> *threadPeer = (std::pair<partitionLink *, int64_t> *) arg;
+  partitionLink_t *link = threadPeer->first;
+  int64_t peer = threadPeer->second;
+  peerTraffic_t &traffic = link->traffic[peer];
+  messageReader_t *reader = new messageReader_t();
+  reader->connection = link->outbound[peer];
+
+  int64_t count = 0;
+  while((count = readMessages(*reader)) > 0)
+  {
+    for(int64_t i = 0; i < count; i++)
+    {
+      const partitionMessage_t &reply = reader->messages[i];
+      if(reply.kind == PARTITION_ACK){
+        ++traffic.acknowledged;
+      }
+      else if(reply.kind == PARTITION_REFUSED){
+        ++traffic.refused;
+        link->onRefund(peer, reply.from, reply.amount);
+      }
+    }
+  }
+  delete reader;
+  if(count < 0){
+    print_error("ERROR: lost the connection to partition " << peer);
+    return (void *) 1;
+  }
+  return NULL;
+}
+
+// Listens, connects to every peer and starts taking their credits
+bool partitionLink :: open(int64_t index, int64_t partitions, const char *directory, \
+  int64_t token, creditHandler_t onCredit, refundHandler_t onRefund)
+{
+  peerTraffic_t none = { 0, 0, 0, 0, 0, 0, 0 };
+  this->index = index;
+  this->partitions = partitions;
+  this->token = token;
+  this->onCredit = onCredit;
+  this->onRefund = onRefund;
+  this->outbound.assign(partitions, -1);
+  this->inbound.assign(partitions, -1);
+  this->pending.assign(partitions, std::vector<partitionMessage_t>());
+  this->traffic.assign(partitions, none);
+  this->threads.clear();
+  this->threadPeers.clear();
+
+  // (the peers that connect before we accept wait in the backlog)
+  this->listenPath = partitionSocketPath(directory, index);
+  this->listener = -1;
+  if(this->claimDirectory(directory) == false){
+    return false;
+  }
+  this->listener = openControlSocket(this->listenPath.c_str(), MAX_PARTITIONS);
+  if(this->listener < 0){
+    return false;
+  }
+  if(this->connectPeers(directory) == false || this->acceptPeers() == false){
+    return false;
+  }
+
+  // A thread serving the credits of each peer, and one reading its replies
+  for(int64_t peer = 0; peer < partitions; peer++){
+    if(peer != index){
+      this->threadPeers.push_back(std::make_pair(this, peer));
+    }
+  }
+  for(size_t k = 0; k < 2 * this->threadPeers.size(); k++)
+  {
+    pthread_t thread;
+    void* (*run)(void *) = (k % 2 == 0) ? serveCredits : readReplies;
+    if(pthread_create(&thread, NULL, run, &this->threadPeers[k / 2]) != 0){
+      print_error("ERROR: failed to start the threads of partition " << index);
+      return false;
+    }
+    this->threads.push_back(thread);
+  }
+  return true;
+}
+
+// Sends the credits held for a peer
+void partitionLink :: sendPending(int64_t peer)
+{
+  std::vector<partitionMessage_t> &credits = this->pending[peer];
+  // (a peer that went away is noticed in finish(): its replies are missing)
+  writeAll(this->outbound[peer], credits.data(), credits.size() * sizeof(partitionMessage_t));
+  credits.clear();
+}
+
+// Queues a credit for a peer
+bool partitionLink :: addCredit(int64_t peer, int64_t from, int64_t to, int64_t amount)
+{
+  partitionMessage_t credit = { PARTITION_CREDIT, from, to, amount };
+  this->pending[peer].push_back(credit);
+  ++this->traffic[peer].sent;
+  this->traffic[peer].sentAmount += amount;
+  return this->pending[peer].size() >= PARTITION_SEND_BATCH;
+}
+
+// Sends the batches that are ready (all of them with everything)
+void partitionLink :: sendCredits(bool everything)
+{
+  for(int64_t peer = 0; peer < this->partitions; peer++)
+  {
+    size_t ready = everything ? 1 : PARTITION_SEND_BATCH;
+    if(peer != this->index && this->pending[peer].size() >= ready){
+      this->sendPending(peer);
+    }
+  }
+}
+
+// Sends what is left, tells the peers we're done and waits until they are
+bool partitionLink :: finish()
+{
+  this->sendCredits(true);
+  for(int64_t peer = 0; peer < this->partitions; peer++){
+    if(peer != this->index){
+      shutdown(this->outbound[peer], SHUT_WR);
+    }
+  }
+  bool complete = true;
+  for(size_t k = 0; k < this->threads.size(); k++)
+  {
+    void *status = NULL;
+    pthread_join(this->threads[k], &status);
+    complete = complete && (status == NULL);
+  }
+  this->threads.clear();
+  // Every credit we sent has its reply
+  for(int64_t peer = 0; peer < this->partitions; peer++)
+  {
+    const peerTraffic_t &traffic = this->traffic[peer];
+    if(traffic.acknowledged + traffic.refused != traffic.sent){
+      print_error("ERROR: partition " << peer << " replied to " \
+        << traffic.acknowledged + traffic.refused << " of " << traffic.sent << " credit(s)");
+      complete = false;
+    }
+  }
+  return complete;
+}
+
+// Closes the connections and stops listening
+void partitionLink :: close()
+{
+  for(int64_t peer = 0; peer < this->partitions; peer++)
+  {
+    if(this->outbound[peer] >= 0){
+      ::close(this->outbound[peer]);
+      this->outbound[peer] = -1;
+    }
+    if(this->inbound[peer] >= 0){
+      ::close(this->inbound[peer]);
+      this->inbound[peer] = -1;
+    }
+  }
+  // (no listener: the socket there, if any, is not ours)
+  if(this->listener >= 0){
+    closeControlSocket(this->listener, this->listenPath.c_str());
+    this->listener = -1;
+  }
+}
+
+int64_t partitionLink :: getIndex()
+{
+  return this->index;
+}
+
+int64_t partitionLink :: getPartitions()
+{
+  return this->partitions;
+}
+
+const peerTraffic_t& partitionLink :: getTraffic(int64_t peer)
+{
+  return this->traffic[peer];
+}
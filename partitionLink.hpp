@@ -0,0 +1,122 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-20T01:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: partitionLink.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-20T01:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __PARTITION_LINK__
+#define __PARTITION_LINK__
+
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Most engine instances a run can be split into
+#define   MAX_PARTITIONS                64
+// How long an instance waits for its peers to come up
+#define   PARTITION_CONNECT_TIMEOUT_MS  30000
+// Credits held for a peer before they are sent
+#define   PARTITION_SEND_BATCH          256
+// Number of the clearing account an instance keeps for a peer in its pool
+// (no account of the input can have it)
+#define   PARTITION_CLEARING_ACCOUNT(peer)  (INT64_MIN + (peer))
+
+// Engine instances of a partitioned run (--partition) exchange credits over
+// Unix domain sockets: every instance listens on <directory>/partition-<i>.sock
+// and connects to each of its peers. The directory must be private to the
+// user, and a peer is only taken if it sends the run's token in its hello.
+// The instance owning the debited account debits it into the clearing
+// account of the peer owning the credited one (phase one) and sends it the
+// credit; the peer applies it from the sender's clearing account and
+// acknowledges it (phase two), or refuses it when it doesn't know the
+// account, and the sender refunds the debit.
+
+enum partitionMessageKind {
+  PARTITION_HELLO = 0,                      // first message of a connection
+  PARTITION_CREDIT = 1,                     // credit `to`, debited from `from`
+  PARTITION_ACK = 2,                        // the credit was applied
+  PARTITION_REFUSED = 3                     // unknown account: refund `from`
+};
+
+// -- Typedefs --
+typedef struct partitionMessage partitionMessage_t;
+typedef struct peerTraffic peerTraffic_t;
+typedef class partitionLink partitionLink_t;
+
+// Applies a credit sent by a peer; false when the account is unknown
+typedef bool (*creditHandler_t)(int64_t peer, int64_t account, int64_t amount);
+// Refunds the debit of a credit the peer refused
+typedef void (*refundHandler_t)(int64_t peer, int64_t account, int64_t amount);
+
+// -- Structures --
+struct partitionMessage {
+  int64_t kind;                             // partitionMessageKind
+  int64_t from;                             // debited account (hello: sender's index)
+  int64_t to;                               // credited account (hello: partitions)
+  int64_t amount;                           // (hello: the run's token)
+};
+
+// Credits exchanged with one peer
+struct peerTraffic {
+  int64_t sent;                             // credits sent to it
+  int64_t sentAmount;
+  int64_t acknowledged;                     // of which it applied
+  int64_t refused;                          // and it refused (refunded here)
+  int64_t received;                         // credits it sent here
+  int64_t receivedAmount;
+  int64_t declined;                         // of which were refused here
+};
+
+// -- Classes --
+class partitionLink
+{
+private:
+  int64_t index;                            // this instance
+  int64_t partitions;
+  int64_t token;                            // of the run, in the hellos
+  std::string listenPath;
+  int listener;
+  std::vector<int> outbound;                // to each peer: credits out, replies in
+  std::vector<int> inbound;                 // from each peer: credits in, replies out
+  std::vector< std::vector<partitionMessage_t> > pending;   // credits not sent yet
+  std::vector<peerTraffic_t> traffic;
+  std::vector<pthread_t> threads;
+  std::vector<std::pair<partitionLink *, int64_t> > threadPeers;  // (link, peer) of each thread
+  creditHandler_t onCredit;
+  refundHandler_t onRefund;
+
+  bool claimDirectory(const char *directory);
+  bool connectPeers(const char *directory);
+  bool acceptPeers();
+  void sendPending(int64_t peer);
+  static void* serveCredits(void *arg);
+  static void* readReplies(void *arg);
+
+public:
+  // Listens, connects to every peer and starts taking their credits; false
+  // if the peers did not all come up in time (or one is of another run)
+  bool open(int64_t index, int64_t partitions, const char *directory, int64_t token, \
+    creditHandler_t onCredit, refundHandler_t onRefund);
+  // Queues a credit for a peer; true once a batch is ready to be sent
+  bool addCredit(int64_t peer, int64_t from, int64_t to, int64_t amount);
+  // Sends the batches that are ready (all of them with everything)
+  void sendCredits(bool everything = false);
+  // Sends what is left and waits for the replies to every credit sent and
+  // for the peers to be done sending; false if a peer went away
+  bool finish();
+  void close();
+  int64_t getIndex();
+  int64_t getPartitions();
+  const peerTraffic_t& getTraffic(int64_t peer);
+};
+
+#endif
@@ -0,0 +1,250 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T10:30:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: resultWriter.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T10:30:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <vector>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "debugMacros.hpp"
+#include "resultWriter.hpp"
+
+// Std namespace
+using namespace std;
+
+
+// "00".."99" for converting two digits at a time
+static const char sDigitPairs[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// Number of decimal digits in value
+static inline int64_t digitCount(uint64_t value)
+{
+  int64_t digits = 1;
+  while(value >= 10000){
+    value /= 10000;
+    digits += 4;
+  }
+  if(value >= 1000) return digits + 3;
+  if(value >= 100) return digits + 2;
+  if(value >= 10) return digits + 1;
+  return digits;
+}
+
+// Number of chars formatInt64() writes for value
+static inline int64_t formattedLength(int64_t value)
+{
+  if(value < 0){
+    return 1 + digitCount(0 - (uint64_t) value);
+  }
+  return digitCount((uint64_t) value);
+}
+
+// Formats value in decimal at dst (no terminating NUL)
+int64_t formatInt64(char *dst, int64_t value)
+{
+  uint64_t magnitude = (uint64_t) value;
+  int64_t length = 0;
+  if(value < 0){
+    *dst++ = '-';
+    magnitude = 0 - magnitude;
+    length = 1;
+  }
+  int64_t digits = digitCount(magnitude);
+  length += digits;
+
+  // fill from the back, two digits at a time
+  char *pos = dst + digits;
+  while(magnitude >= 100){
+    uint64_t pair = (magnitude % 100) * 2;
+    magnitude /= 100;
+    *--pos = sDigitPairs[pair + 1];
+    *--pos = sDigitPairs[pair];
+  }
+  if(magnitude >= 10){
+    *--pos = sDigitPairs[magnitude * 2 + 1];
+    *--pos = sDigitPairs[magnitude * 2];
+  }
+  else {
+    *--pos = (char) ('0' + magnitude);
+  }
+  return length;
+}
+
+// Formats one "<account> <balance>\n" line at dst
+static inline int64_t formatLine(char *dst, int64_t account, int64_t balance)
+{
+  int64_t length = formatInt64(dst, account);
+  dst[length++] = ' ';
+  length += formatInt64(dst + length, balance);
+  dst[length++] = '\n';
+  return length;
+}
+
+// write() the whole range, retrying on partial writes
+static int64_t writeAll(int fd, const char *data, size_t size)
+{
+  while(size > 0){
+    ssize_t written = write(fd, data, size);
+    if(written < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      return FAIL;
+    }
+    data += written;
+    size -= written;
+  }
+  return SUCCESS;
+}
+
+
+// -- stdout: format into a large buffer and flush it when full
+static int64_t writeBalancesToStdout(bankAccountPool_t *accountPool, \
+  const vector<int64_t> &accounts, const vector<int64_t> &slots)
+{
+  // anything already buffered by std::cout goes first
+  std::cout.flush();
+
+  vector<char> buffer(WRITER_BUFFERSIZE);
+  // a line is at most 2 x 20 digits + sign + separators
+  const size_t maxLine = 64;
+  size_t used = 0;
+  for(size_t i = 0; i < accounts.size(); i++)
+  {
+    if(used + maxLine > buffer.size()){
+      if(writeAll(STDOUT_FILENO, buffer.data(), used) == FAIL){
+        return FAIL;
+      }
+      used = 0;
+    }
+    used += formatLine(buffer.data() + used, accounts[i], \
+      accountPool->atSlot(slots[i])->getBalance());
+  }
+  return writeAll(STDOUT_FILENO, buffer.data(), used);
+}
+
+
+// Slice of the output file filled by one thread
+typedef struct writerSlice {
+  bankAccountPool_t *accountPool;
+  const vector<int64_t> *accounts;
+  const vector<int64_t> *slots;
+  char *output;                   // start of this slice in the mapping
+  int64_t first;                  // first line of the slice
+  int64_t last;                   // one past the last line
+} writerSlice_t;
+
+static void* writeSlice(void *arg)
+{
+  writerSlice_t *slice = (writerSlice_t *) arg;
+  char *pos = slice->output;
+  for(int64_t i = slice->first; i < slice->last; i++){
+    pos += formatLine(pos, (*slice->accounts)[i], \
+      slice->accountPool->atSlot((*slice->slots)[i])->getBalance());
+  }
+  return NULL;
+}
+
+// -- output file: size every line up front, then fill slices in parallel
+static int64_t writeBalancesToFile(bankAccountPool_t *accountPool, \
+  const vector<int64_t> &accounts, const vector<int64_t> &slots, \
+  const char *outputPath, int64_t threads)
+{
+  int64_t lines = accounts.size();
+  if(threads < 1) threads = 1;
+  if(threads > MAX_WRITER_THREADS) threads = MAX_WRITER_THREADS;
+  if(threads > lines) threads = (lines > 0) ? lines : 1;
+
+  // byte offset at which each slice starts
+  vector<int64_t> sliceStart(threads + 1, 0);
+  int64_t offset = 0;
+  for(int64_t t = 0, i = 0; t < threads; t++){
+    int64_t last = lines * (t + 1) / threads;
+    sliceStart[t] = offset;
+    for(; i < last; i++){
+      offset += formattedLength(accounts[i]) + 2 + \
+        formattedLength(accountPool->atSlot(slots[i])->getBalance());
+    }
+  }
+  sliceStart[threads] = offset;
+
+  int fd = open(outputPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0){
+    print_output("Failed to open the output file: " << outputPath);
+    return FAIL;
+  }
+  if(offset == 0){
+    close(fd);
+    return SUCCESS;
+  }
+  if(ftruncate(fd, offset) != 0){
+    print_output("Failed to resize the output file: " << outputPath);
+    close(fd);
+    return FAIL;
+  }
+  char *output = (char *) mmap(NULL, offset, PROT_READ | PROT_WRITE, \
+    MAP_SHARED, fd, 0);
+  if(output == MAP_FAILED){
+    print_output("Failed to map the output file: " << outputPath);
+    close(fd);
+    return FAIL;
+  }
+
+  vector<writerSlice_t> slices(threads);
+  vector<pthread_t> writers(threads);
+  for(int64_t t = 0; t < threads; t++){
+    slices[t].accountPool = accountPool;
+    slices[t].accounts = &accounts;
+    slices[t].slots = &slots;
+    slices[t].output = output + sliceStart[t];
+    slices[t].first = lines * t / threads;
+    slices[t].last = lines * (t + 1) / threads;
+  }
+  // the calling thread fills the first slice itself
+  int64_t started = 1;
+  for(; started < threads; started++){
+    if(pthread_create(&writers[started], NULL, writeSlice, &slices[started]) != 0){
+      break;
+    }
+  }
+  writeSlice(&slices[0]);
+  for(int64_t t = 1; t < threads; t++){
+    if(t < started){
+      pthread_join(writers[t], NULL);
+    }
+    else {
+      writeSlice(&slices[t]);
+    }
+  }
+
+  munmap(output, offset);
+  close(fd);
+  return SUCCESS;
+}
+
+
+// Writes the balances of all accounts in the given order
+int64_t writeBalances(bankAccountPool_t *accountPool, \
+  const vector<int64_t> &accounts, const vector<int64_t> &slots, \
+  const char *outputPath, int64_t threads)
+{
+  if(outputPath == NULL){
+    return writeBalancesToStdout(accountPool, accounts, slots);
+  }
+  return writeBalancesToFile(accountPool, accounts, slots, outputPath, threads);
+}
@@ -0,0 +1,37 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T10:30:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: resultWriter.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T10:30:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __RESULT_WRITER__
+#define __RESULT_WRITER__
+
+
+#include <vector>
+#include <stdint.h>
+
+#include "bankAccount.hpp"
+
+// Size of the staging buffer used for stdout
+#define   WRITER_BUFFERSIZE       (1 << 20)
+// Maximum threads used to fill an output file
+#define   MAX_WRITER_THREADS      64
+
+// Formats value in decimal at dst; returns the number of chars written
+int64_t formatInt64(char *dst, int64_t value);
+
+// Writes "<account> <balance>\n" for every account (in the given order)
+// to stdout, or to outputPath using "threads" slices of an mmap'd file.
+// Slots must come from bankAccountPool::addAccount().
+int64_t writeBalances(bankAccountPool_t *accountPool, \
+  const std::vector<int64_t> &accounts, const std::vector<int64_t> &slots, \
+  const char *outputPath, int64_t threads);
+
+#endif
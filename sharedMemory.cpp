@@ -0,0 +1,273 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T14:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: sharedMemory.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T14:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "debugMacros.hpp"
+#include "sharedMemory.hpp"
+
+// Std namespace
+using namespace std;
+
+
+// Backing of the last huge page mapping
+static int64_t sLastBacking = PAGES_DEFAULT;
+// perf counters (-1 when unavailable)
+static int sDTLBMisses = -1;
+static int sITLBMisses = -1;
+
+
+// Huge page size from /proc/meminfo
+static size_t hugePageSize()
+{
+  static size_t sHugePageSize = 0;
+  if(sHugePageSize != 0){
+    return sHugePageSize;
+  }
+  sHugePageSize = DEFAULT_HUGEPAGE_SIZE;
+  FILE *meminfo = fopen("/proc/meminfo", "r");
+  if(meminfo == NULL){
+    return sHugePageSize;
+  }
+  char line[128];
+  unsigned long sizeKB = 0;
+  while(fgets(line, sizeof(line), meminfo) != NULL){
+    if(sscanf(line, "Hugepagesize: %lu kB", &sizeKB) == 1 && sizeKB > 0){
+      sHugePageSize = sizeKB * 1024;
+      break;
+    }
+  }
+  fclose(meminfo);
+  return sHugePageSize;
+}
+
+// Maps anonymous memory shared with forked workers
+void* mapSharedMemory(size_t *size, bool hugePages)
+{
+  void *memory = MAP_FAILED;
+  if(hugePages == true)
+  {
+    size_t pageSize = hugePageSize();
+    *size = (*size + pageSize - 1) / pageSize * pageSize;
+
+    // 1. explicit huge pages (needs vm.nr_hugepages reserved)
+    memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, \
+      MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(memory != MAP_FAILED){
+      sLastBacking = PAGES_HUGETLB;
+      return memory;
+    }
+    dbg_trace("MAP_HUGETLB failed for " << *size << " bytes; using THP advice");
+  }
+
+  memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, \
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(memory == MAP_FAILED){
+    return NULL;
+  }
+  if(hugePages == true)
+  {
+    // 2. transparent huge pages
+    sLastBacking = PAGES_DEFAULT;
+    if(madvise(memory, *size, MADV_HUGEPAGE) == 0){
+      sLastBacking = PAGES_TRANSPARENT;
+    }
+  }
+  return memory;
+}
+
+// Backing of the last mapping made with hugePages set
+int64_t lastPageBacking()
+{
+  return sLastBacking;
+}
+
+
+// Name of a POSIX shared memory segment: "/" + name + suffix
+std::string sharedSegmentName(const char *name, const char *suffix)
+{
+  std::string segmentName = (name[0] == '/') ? name : std::string("/") + name;
+  return segmentName + suffix;
+}
+
+// Maps memory backed by a named POSIX shared memory segment
+void* mapNamedSharedMemory(const char *segmentName, size_t *size, bool hugePages)
+{
+  int fd = shm_open(segmentName, O_CREAT | O_TRUNC | O_RDWR, 0600);
+  if(fd < 0){
+    dbg_trace("shm_open(" << segmentName << ") failed: " << strerror(errno));
+    return NULL;
+  }
+  if(ftruncate(fd, *size) != 0){
+    close(fd);
+    shm_unlink(segmentName);
+    return NULL;
+  }
+  void *memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(memory == MAP_FAILED){
+    shm_unlink(segmentName);
+    return NULL;
+  }
+  // shm segments can't use MAP_HUGETLB; only the advice applies
+  if(hugePages == true)
+  {
+    sLastBacking = PAGES_DEFAULT;
+    if(madvise(memory, *size, MADV_HUGEPAGE) == 0){
+      sLastBacking = PAGES_TRANSPARENT;
+    }
+  }
+  return memory;
+}
+
+// Reserves address space shared with forked workers
+void* reserveSharedMemory(size_t *size, bool hugePages, const char *segmentName)
+{
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  *size = (*size + pageSize - 1) / pageSize * pageSize;
+  void *memory = MAP_FAILED;
+  if(segmentName != NULL)
+  {
+    // (a sparse segment: tmpfs only counts the pages that are written)
+    int fd = shm_open(segmentName, O_CREAT | O_TRUNC | O_RDWR, 0600);
+    if(fd < 0){
+      dbg_trace("shm_open(" << segmentName << ") failed: " << strerror(errno));
+      return NULL;
+    }
+    if(ftruncate(fd, *size) == 0){
+      memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+    }
+    close(fd);
+    if(memory == MAP_FAILED){
+      shm_unlink(segmentName);
+      return NULL;
+    }
+  }
+  else
+  {
+    memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, \
+      MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(memory == MAP_FAILED){
+      return NULL;
+    }
+  }
+  if(hugePages == true)
+  {
+    sLastBacking = PAGES_DEFAULT;
+    if(madvise(memory, *size, MADV_HUGEPAGE) == 0){
+      sLastBacking = PAGES_TRANSPARENT;
+    }
+  }
+  return memory;
+}
+
+// Backs a range of a reservation now, so running out of memory shows up
+// here instead of as a SIGBUS on the first write to it
+bool commitSharedMemory(void *memory, size_t size)
+{
+#ifdef MADV_POPULATE_WRITE
+  size_t pageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t) memory / pageSize * pageSize;
+  uintptr_t end = ((uintptr_t) memory + size + pageSize - 1) / pageSize * pageSize;
+  if(madvise((void *) start, end - start, MADV_POPULATE_WRITE) != 0){
+    // (kernels before 5.14 don't know it; the pages are faulted in on use)
+    if(errno != EINVAL){
+      dbg_trace("Failed to commit " << end - start << " bytes: " << strerror(errno));
+      return false;
+    }
+  }
+#endif
+  return true;
+}
+
+// Maps an existing named segment read-only
+void* attachNamedSharedMemory(const char *segmentName, size_t *size)
+{
+  int fd = shm_open(segmentName, O_RDONLY, 0);
+  if(fd < 0){
+    return NULL;
+  }
+  struct stat status;
+  if(fstat(fd, &status) != 0 || status.st_size == 0){
+    close(fd);
+    return NULL;
+  }
+  *size = status.st_size;
+  void *memory = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return (memory == MAP_FAILED) ? NULL : memory;
+}
+
+
+// Opens a TLB miss counter inherited by the forked workers
+static int openTLBCounter(uint64_t cache)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.disabled = 1;
+  int fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  if(fd >= 0){
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  return fd;
+}
+
+static void reportTLBCounter(const char *name, int fd)
+{
+  uint64_t count = 0;
+  if(fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)){
+    print_error(name << ": unavailable");
+    return;
+  }
+  print_error(name << ": " << count);
+}
+
+// Starts the TLB miss counters; must run before the workers are forked
+void startMemoryCounters()
+{
+  sDTLBMisses = openTLBCounter(PERF_COUNT_HW_CACHE_DTLB);
+  sITLBMisses = openTLBCounter(PERF_COUNT_HW_CACHE_ITLB);
+}
+
+// Reports page faults and TLB misses (call after the workers were reaped)
+void reportMemoryCounters()
+{
+  struct rusage self, children;
+  getrusage(RUSAGE_SELF, &self);
+  getrusage(RUSAGE_CHILDREN, &children);
+  print_error("Page faults (minor/major): parser " << self.ru_minflt << "/" \
+    << self.ru_majflt << " , workers " << children.ru_minflt << "/" \
+    << children.ru_majflt);
+  reportTLBCounter("dTLB load misses", sDTLBMisses);
+  reportTLBCounter("iTLB load misses", sITLBMisses);
+
+  const char *backing[] = { "4K pages", "explicit huge pages", \
+    "transparent huge pages (advised)" };
+  print_error("Account pool backed by: " << backing[sLastBacking]);
+}
@@ -0,0 +1,62 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T14:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: sharedMemory.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T14:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __SHARED_MEMORY__
+#define __SHARED_MEMORY__
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Huge page size assumed when /proc/meminfo can't tell
+#define   DEFAULT_HUGEPAGE_SIZE   (2 * 1024 * 1024)
+
+// How a mapping ended up being backed
+enum pageBackingType {
+  PAGES_DEFAULT = 0,          // regular 4K pages
+  PAGES_HUGETLB = 1,          // explicit huge pages (MAP_HUGETLB)
+  PAGES_TRANSPARENT = 2       // regular mapping advised for transparent huge pages
+};
+
+// Maps anonymous memory shared with forked workers. With hugePages, *size is
+// rounded up to the huge page size and explicit huge pages are tried first,
+// then transparent huge page advice. Returns NULL on failure.
+void* mapSharedMemory(size_t *size, bool hugePages);
+// Backing of the last mapping made with hugePages set
+int64_t lastPageBacking();
+
+// Reserves address space shared with forked workers, backed only as it is
+// committed (MAP_NORESERVE); *size is rounded up to whole pages. With a
+// segmentName it is backed by that named segment (replaced if it exists).
+// With hugePages it is advised for transparent huge pages: explicit huge
+// pages can't be reserved without setting them aside. Returns NULL on failure.
+void* reserveSharedMemory(size_t *size, bool hugePages, const char *segmentName = NULL);
+// Backs [memory, memory + size) of a reservation now (widened to whole
+// pages); false if there is no memory left for it
+bool commitSharedMemory(void *memory, size_t size);
+
+// Name of a POSIX shared memory segment: "/" + name + suffix
+std::string sharedSegmentName(const char *name, const char *suffix = "");
+// Same as mapSharedMemory(), but backed by the named segment so another
+// process can attach to it (an existing segment of that name is replaced).
+// With hugePages the segment is advised for transparent huge pages.
+void* mapNamedSharedMemory(const char *segmentName, size_t *size, bool hugePages);
+// Maps an existing named segment read-only; *size gets its size. Returns
+// NULL if there is no such segment.
+void* attachNamedSharedMemory(const char *segmentName, size_t *size);
+
+// Page fault and TLB miss counters of this process and its (exited) children
+void startMemoryCounters();
+void reportMemoryCounters();
+
+#endif
@@ -0,0 +1,67 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T16:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: sharedState.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T16:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __SHARED_STATE__
+#define __SHARED_STATE__
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "transfProg.hpp"
+
+// Layout of the named segments made with --shm-name <name>:
+//   /<name>       control segment: sharedStateHeader_t, then the
+//                 bankAccountPool_t, then processData_t[numberOfWorkers]
+//   /<name>.pool  the nodes of the account pool (see bankAccountPool)
+// The pool nodes link to each other with pointers of transfProg's address
+// space; attach to the pool segment and rebase them by the pool memory base.
+
+#define   SHARED_STATE_MAGIC      0x3130455441545345ULL     // "ESTATE01"
+#define   POOL_SEGMENT_SUFFIX     ".pool"
+
+// Stage of the run that owns the segments
+enum sharedStateStage {
+  STAGE_LOADING = 0,                        // reading the accounts
+  STAGE_TRANSFERS = 1,                      // transfers being dispatched
+  STAGE_DONE = 2                            // workers reaped, printing balances
+};
+
+// -- Typedefs --
+typedef struct sharedStateHeader sharedStateHeader_t;
+
+// Head of the control segment
+struct sharedStateHeader {
+  uint64_t magic;                           // SHARED_STATE_MAGIC once ready
+  int64_t ownerPID;                         // transfProg
+  int64_t startNs;                          // monotonicNs() when it started
+  int64_t numberOfWorkers;                  // entries of processData_t[]
+  int64_t stage;                            // sharedStateStage
+};
+
+// Offsets of the parts of the control segment
+inline size_t sharedPoolOffset()
+{
+  return (sizeof(sharedStateHeader_t) + 63) & ~(size_t) 63;
+}
+
+inline size_t sharedProcessDataOffset()
+{
+  return (sharedPoolOffset() + sizeof(bankAccountPool_t) + 63) & ~(size_t) 63;
+}
+
+inline size_t sharedStateSize(int64_t numberOfWorkers)
+{
+  return sharedProcessDataOffset() + sizeof(processData_t) * numberOfWorkers;
+}
+
+#endif
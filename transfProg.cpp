@@ -11,164 +11,863 @@
 
 
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
 #include <cstring>
+#include <cinttypes>
 #include <stdlib.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <assert.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
 
 #include "debugMacros.hpp"
 #include "transfProg.hpp"
+#include "resultWriter.hpp"
+#include "transferCoalescer.hpp"
+#include "transferEngine.hpp"
+#include "sharedMemory.hpp"
+#include "workloadStats.hpp"
+#include "sharedState.hpp"
+#include "controlSocket.hpp"
+#include "inputReader.hpp"
+#include "lineParser.hpp"
+#include "crashRecovery.hpp"
+#include "partitionLink.hpp"
 
 
 // Std namespace
 using namespace std;
 
+// Where the parser sends the requests
+typedef struct dispatcher {
+  processData_t **processData;
+  int64_t NumberOfProcesses;
+  int64_t assignID;                         // worker that got the last request
+  bankAccountPool_t *accountPool;
+  bool sequential;                          // apply in place; no workers
+  int64_t firstCommitNs;                    // first request applied in place
+  bool timed;                               // timestamp requests for the lane latencies
+  const transfOptions_t *options;           // (to respawn a crashed worker)
+  traceRing_t *trace;                       // timeline of this producer (NULL: off)
+} dispatcher_t;
+
+// A transfer source read by its own producer thread, with its own round
+// robin (and coalescer), into the same worker queues
+typedef struct producer {
+  const char *fileName;
+  dispatcher_t dispatcher;
+  parseStats_t stats;
+  int64_t status;                           // SUCCESS once read
+  int64_t elapsedNs;                        // time taken to read and dispatch it
+  pthread_t thread;
+  bool started;                             // (false: it was read inline)
+} producer_t;
+
+// When main() started (for the time to the first committed transfer)
+static int64_t programStartNs = 0;
+// Control segment of --shm-name (NULL with anonymous mappings)
+static sharedStateHeader_t *sharedState = NULL;
+// Socket the daemon listens on (-1 until it does)
+static int daemonControlSocket = -1;
+// Timeline rings of the producers, the parser's first (empty without --trace)
+static std::vector<traceRing_t *> producerTraces;
+// --ordered: the next turn on each account slot, i.e. the transfers on it
+// dispatched so far (parser only)
+static std::vector<int64_t> accountTurns;
+// Transfer files given after the worker count (directories expanded)
+static std::vector<std::string> transferSources;
+// With several producers, they hold this (shared) while they look accounts
+// up and push; accounts are opened, and crashed workers recovered, with it
+// held exclusively, so the tree never changes under a lookup nor a queue
+// is repaired under a push
+static pthread_rwlock_t dispatchLock;
+static bool concurrentProducers = false;
+// --partition: this instance's range of the accounts, its links to the
+// other instances, the partition owning each account not in our pool, and
+// the slots of the peers' clearing accounts (our transfers to and from
+// their accounts go through those)
+static int64_t partitionIndex = 0;
+static int64_t partitionCount = 1;
+static const char *partitionDirectory = NULL;
+static partitionLink_t partitionLink;
+static std::unordered_map<int64_t, int64_t> accountOwners;
+static std::vector<int64_t> clearingSlots;
+// Round robins of the threads applying the peers' credits, and the refunds
+// of the credits they refused
+static std::vector<dispatcher_t> creditDispatchers;
+static std::vector<dispatcher_t> refundDispatchers;
+// Set once the parser is done with the input (every account is open)
+static bool partitionParsed = false;
+static int64_t partitionStartNs = 0;
+// Token of the run every instance sends its peers: a hash of the account
+// lines of the input and the number of partitions
+static int64_t partitionToken = 0;
+
 // To save the order in which accounts are listed
 std::vector<int64_t> accountList;
+// Pool slot of each account in accountList
+std::vector<int64_t> accountSlots;
+
+/* --partition: keep the accounts of our range of the input (the i-th of
+   the n equal ranges of its account lines); the others are only known by
+   the partition owning them. An account listed twice belongs to the range
+   of its first line. The lines are hashed into the run's token, so that
+   only instances reading the same accounts take each other as peers. */
+static void partitionAccounts(std::vector<accountRecord_t> &accountRecords)
+{
+  size_t count = accountRecords.size();
+  size_t kept = 0;
+  uint64_t token = (14695981039346656037ULL ^ (uint64_t) partitionCount) * 1099511628211ULL;
+  for(size_t k = 0; k < count; k++)
+  {
+    token = (token ^ (uint64_t) accountRecords[k].number) * 1099511628211ULL;
+    token = (token ^ (uint64_t) accountRecords[k].balance) * 1099511628211ULL;
+    int64_t owner = (int64_t) ((k * partitionCount) / count);
+    std::pair<std::unordered_map<int64_t, int64_t>::iterator, bool> first = \
+      accountOwners.insert(std::make_pair(accountRecords[k].number, owner));
+    if(owner == partitionIndex && first.first->second == partitionIndex){
+      accountRecords[kept++] = accountRecords[k];
+    }
+  }
+  accountRecords.resize(kept);
+  for(size_t k = 0; k < kept; k++){
+    accountOwners.erase(accountRecords[k].number);
+  }
+  partitionToken = (int64_t) token;
+}
+
+/* Bulk load the accounts read so far into the account pool */
+static void loadAccounts(bankAccountPool_t *accountPool, \
+  std::vector<accountRecord_t> &accountRecords)
+{
+  if(partitionCount > 1){
+    partitionAccounts(accountRecords);
+  }
+  std::vector<int64_t> slots(accountRecords.size());
+  accountPool->bulkLoadAccounts(accountRecords.data(), accountRecords.size(), \
+    slots.data());
+
+  // Accounts that did not fit in the pool are not listed
+  for(size_t i = 0; i < accountRecords.size(); i++){
+    if(slots[i] == -1){
+      dbg_trace("Account Pool is full! Dropping account: " << accountRecords[i].number);
+      continue;
+    }
+    accountList.push_back(accountRecords[i].number);
+    accountSlots.push_back(slots[i]);
+  }
+  accountRecords.clear();
+  accountRecords.shrink_to_fit();
+
+  // --partition: a clearing account per peer (not listed)
+  if(partitionCount > 1){
+    for(int64_t peer = 0; peer < partitionCount; peer++){
+      clearingSlots.push_back(accountPool->addAccount(PARTITION_CLEARING_ACCOUNT(peer), 0));
+    }
+  }
+}
+
+/* Timeline ring of producer k (NULL without --trace) */
+static traceRing_t* producerTrace(size_t k)
+{
+  return (k < producerTraces.size()) ? producerTraces[k] : NULL;
+}
+
+/* --ordered: takes the next turn on the account at slot */
+static int64_t takeTurn(int64_t slot)
+{
+  if(slot >= (int64_t) accountTurns.size()){
+    accountTurns.resize(std::max<int64_t>(slot + 1, 2 * accountTurns.size()), 0);
+  }
+  return accountTurns[slot]++;
+}
+
+/* --ordered: gives a request (and its legs) its turn on each of its
+   accounts; a transfer to the same account changes nothing and needs none */
+static void takeTurns(EFTRequest_t *request)
+{
+  if(request->legs == 0 && request->fromSlot == request->toSlot){
+    return;
+  }
+  request->fromSeq = takeTurn(request->fromSlot);
+  for(int64_t i = 0; i <= request->legs; i++){
+    request[i].toSeq = takeTurn(request[i].toSlot);
+  }
+}
+
+/* Look accounts up and push requests (shared with the other producers) */
+static inline void lockDispatch()
+{
+  if(concurrentProducers == true){
+    pthread_rwlock_rdlock(&dispatchLock);
+  }
+}
+
+static inline void unlockDispatch()
+{
+  if(concurrentProducers == true){
+    pthread_rwlock_unlock(&dispatchLock);
+  }
+}
+
+/* A queue stayed full: its worker may have died. Reap (and recover) the
+   crashed workers, with no other producer pushing meanwhile; the caller
+   holds the dispatch lock (shared) when there are several producers */
+static void reapCrashedWorkers(dispatcher_t &dispatcher)
+{
+  if(concurrentProducers == false){
+    reapWorkers(dispatcher.processData, dispatcher.NumberOfProcesses, *dispatcher.options, \
+      false);
+    return;
+  }
+  pthread_rwlock_unlock(&dispatchLock);
+  pthread_rwlock_wrlock(&dispatchLock);
+    reapWorkers(dispatcher.processData, dispatcher.NumberOfProcesses, *dispatcher.options, \
+      false);
+  pthread_rwlock_unlock(&dispatchLock);
+  pthread_rwlock_rdlock(&dispatchLock);
+}
+
+/* Hand a request to the next worker (round robin), or apply it right here
+   when running the sequential engine */
+static void dispatchRequest(dispatcher_t &dispatcher, EFTRequest_t *newRequest)
+{
+  if(dispatcher.sequential == true){
+    EFTApplySequential(dispatcher.accountPool, newRequest);
+    if(dispatcher.firstCommitNs == 0){
+      dispatcher.firstCommitNs = monotonicNs();
+    }
+    return;
+  }
+  processData_t **processData = dispatcher.processData;
+  int64_t &assignID = dispatcher.assignID;
+
+  // Assign the job to next worker
+  assignID = (assignID + 1) % dispatcher.NumberOfProcesses;
+
+  assert(processData[assignID]->processID == assignID);    // Sanity checks
+  assert(processData[assignID]->processID \
+    == processData[assignID]->EFTRequests.getWorkerID());
+
+  // (the legs of a multi-leg transfer, which follow it, go along with it)
+  for(int64_t i = 0; i <= newRequest->legs; i++){
+    newRequest[i].workerID = assignID;
+  }
+  newRequest->enqueueNs = dispatcher.timed ? monotonicNs() : 0;
+  if(dispatcher.options->ordered == true){
+    takeTurns(newRequest);
+  }
+
+  // Start writing;
+  // NOTE:: this is data-race safe since the workerQueue class implements
+  // safe IPC using mutex and condition varibales
+  // (a queue that stays full may belong to a worker that died; it is
+  // recovered and respawned before we try again)
+  int64_t pushStart = (dispatcher.trace != NULL) ? monotonicNs() : 0;
+  while(processData[assignID]->EFTRequests.pushRequest(newRequest, \
+        QUEUE_PUSH_TIMEOUT_MS) == false){
+    reapCrashedWorkers(dispatcher);
+  }
+  __atomic_fetch_add(&processData[assignID]->dispatched, 1, __ATOMIC_RELAXED);
+  if(dispatcher.trace != NULL){
+    traceWait(dispatcher.trace, TRACE_PUSH_BLOCKED, pushStart, monotonicNs());
+  }
+
+  /*dbg_trace("[Thread ID: " << processData[assignID]->processID << ","\
+  << "Job Assigned ID: " << assignID << ","\
+  << "Queue ID: " << processData[assignID]->EFTRequests.getWorkerID() << "]");*/
+}
+
+/* Dispatch the net requests of the coalescer's current window */
+static void flushCoalescer(transferCoalescer_t &coalescer, dispatcher_t &dispatcher, \
+  int64_t &requestCount)
+{
+  std::vector<EFTRequest_t> netRequests;
+  coalescer.flush(netRequests);
+  for(size_t i = 0; i < netRequests.size(); i++){
+    dispatchRequest(dispatcher, &netRequests[i]);
+    ++requestCount;
+  }
+}
+
+/* --partition: whether a transfer from an account not in our pool is left
+   to the partition owning it (one from an unknown account is rejected by
+   partition 0) */
+static bool leftToOtherPartition(int64_t fromAccount)
+{
+  return partitionCount > 1 && (accountOwners.count(fromAccount) > 0 || partitionIndex != 0);
+}
+
+/* Slot a transfer from one of our accounts credits: the account's, or with
+   --partition, the clearing account of the peer owning it (-1: unknown) */
+static int64_t creditSlot(bankAccountPool_t *accountPool, int64_t account, int64_t &peer)
+{
+  peer = -1;
+  int64_t slot = accountPool->slotOf(account);
+  if(slot != -1 || partitionCount == 1){
+    return slot;
+  }
+  std::unordered_map<int64_t, int64_t>::iterator owner = accountOwners.find(account);
+  if(owner == accountOwners.end()){
+    return -1;
+  }
+  peer = owner->second;
+  return clearingSlots[peer];
+}
+
+/* Parse a multi-leg transfer line and dispatch it as one request: its
+   first credit, followed by the other ones as its legs */
+static void dispatchSplit(const char *line, size_t length, dispatcher_t &dispatcher, \
+  parseStats_t &stats)
+{
+  // "Split <from> <to> <amount> [<to> <amount>]..." (up to MAX_TRANSFER_LEGS
+  // credits; the debit is their sum)
+  int64_t fields[2 * MAX_TRANSFER_LEGS + 3];
+  int64_t parsed = parseLineFields(line, length, true, fields, 2 * MAX_TRANSFER_LEGS + 3);
+  int64_t credits = (parsed - 1) / 2;
+  if(parsed < 3){
+    return;
+  }
+  int64_t fromSlot = dispatcher.accountPool->slotOf(fields[0]);
+  if(fromSlot == -1 && leftToOtherPartition(fields[0])){
+    return;
+  }
+  if(credits > MAX_TRANSFER_LEGS){
+    dbg_trace("Rejected multi-leg transfer with over " << MAX_TRANSFER_LEGS << " credits");
+    ++stats.rejected;
+    return;
+  }
+
+  // Resolve the accounts; one unknown account rejects the whole transfer.
+  // Credits to the same account are merged, and a credit to the debited
+  // account cancels out, so the worker locks distinct accounts.
+  EFTRequest_t requests[MAX_TRANSFER_LEGS];
+  int64_t count = 0;
+  int64_t peer = -1;
+  for(int64_t i = 0; i < credits; i++){
+    int64_t toSlot = creditSlot(dispatcher.accountPool, fields[1 + 2 * i], peer);
+    if(fromSlot == -1 || toSlot == -1){
+      dbg_trace("Rejected multi-leg transfer with unknown account: " << fields[1 + 2 * i]);
+      ++stats.rejected;
+      return;
+    }
+    int64_t leg = 0;
+    while(leg < count && requests[leg].toSlot != toSlot){
+      ++leg;
+    }
+    if(leg == count){
+      EFTRequest_t credit = { -1, fromSlot, toSlot, 0, LANE_BULK, 0, 0, -1, -1 };
+      requests[count++] = credit;
+    }
+    requests[leg].transferAmount += fields[2 + 2 * i];
+  }
+  int64_t legs = 0;
+  for(int64_t i = 0; i < count; i++){
+    if(requests[i].toSlot != fromSlot){
+      requests[legs++] = requests[i];
+    }
+  }
+  if(legs == 0){
+    return;
+  }
+  requests[0].legs = legs - 1;
+  dispatchRequest(dispatcher, requests);
+  ++stats.requests;
+
+  // --partition: the credits to other partitions' accounts (debited into
+  // their clearing accounts along with the other legs)
+  for(int64_t i = 0; i < credits && partitionCount > 1; i++){
+    creditSlot(dispatcher.accountPool, fields[1 + 2 * i], peer);
+    if(peer != -1){
+      partitionLink.addCredit(peer, fields[0], fields[1 + 2 * i], fields[2 + 2 * i]);
+    }
+  }
+}
+
+/* Parse a transfer line and dispatch it, through the coalescer when there
+   is one */
+static void dispatchTransfer(const char *line, size_t length, dispatcher_t &dispatcher, \
+  transferCoalescer_t *coalescer, parseStats_t &stats)
+{
+  // (multi-leg transfers are not netted: they would lose their atomicity)
+  if(line[0] == 'S'){
+    dispatchSplit(line, length, dispatcher, stats);
+    return;
+  }
+
+  // "Transfer <from> <to> <amount> [<priority>]"; a priority above 0 makes
+  // the transfer urgent
+  int64_t fields[4] = { -1, -1, 0, 0 };
+  parseLineFields(line, length, true, fields, 4);
+  int64_t fromAccount = fields[0], toAccount = fields[1];
+  int64_t transferAmount = fields[2], priority = fields[3];
+  dbg_trace("From: " << fromAccount << \
+  " To: " << toAccount << " Amount: " << transferAmount << " Priority: " << priority);
+
+  // Stop reading once we've reached invalid accounts i.e. EOF
+  if(fromAccount == -1 || toAccount == -1){
+    return;
+  }
+
+  // Resolve the accounts once; workers only ever see pool slots (with
+  // --partition, a transfer to another partition's account is debited into
+  // its clearing account here, and the credit is sent to it after the line)
+  int64_t fromSlot = dispatcher.accountPool->slotOf(fromAccount);
+  if(fromSlot == -1 && leftToOtherPartition(fromAccount)){
+    return;
+  }
+  int64_t peer = -1;
+  int64_t toSlot = creditSlot(dispatcher.accountPool, toAccount, peer);
+  if(fromSlot == -1 || toSlot == -1){
+    dbg_trace("Rejected transfer with unknown account: " \
+      << fromAccount << " -> " << toAccount);
+    ++stats.rejected;
+    return;
+  }
+  if(peer != -1){
+    partitionLink.addCredit(peer, fromAccount, toAccount, transferAmount);
+  }
+
+  // (urgent transfers are not held back in the coalescer's window)
+  if(coalescer != NULL && priority <= 0){
+    if(coalescer->addTransfer(fromSlot, toSlot, transferAmount) == true){
+      flushCoalescer(*coalescer, dispatcher, stats.requests);
+    }
+    return;
+  }
+
+  // Create new EFT request and assign the job to next worker
+  EFTRequest_t newRequest;
+  newRequest.fromSlot = fromSlot;
+  newRequest.toSlot = toSlot;
+  newRequest.transferAmount = transferAmount;
+  // (with --ordered, the urgent lane would overtake the transfers before it)
+  newRequest.lane = (priority > 0 && dispatcher.options->ordered == false) ? \
+    LANE_URGENT : LANE_BULK;
+  newRequest.legs = 0;
+  newRequest.fromSeq = -1;
+  newRequest.toSeq = -1;
+  dispatchRequest(dispatcher, &newRequest);
+  ++stats.requests;
+}
+
+/* Open an account among the transfers: "Open <account> <balance>". It is
+   in the pool before any later transfer can name it, so the workers only
+   get slots of complete accounts; an account that is already open is left
+   alone (as with a duplicate account line) */
+static void openAccount(const char *line, size_t length, dispatcher_t &dispatcher)
+{
+  int64_t fields[2] = { -1, 0 };
+  parseLineFields(line, length, true, fields, 2);
+  int64_t accountNumber = fields[0], initBalance = fields[1];
+  if(accountNumber == -1){
+    return;
+  }
+  if(concurrentProducers == true){
+    pthread_rwlock_wrlock(&dispatchLock);
+  }
+    bankAccountPool_t *accountPool = dispatcher.accountPool;
+    if(accountPool->slotOf(accountNumber) != -1 || accountOwners.count(accountNumber) > 0){
+      dbg_trace("Account " << accountNumber << " is already open");
+    }
+    // (--partition: the accounts opened along the way are the last partition's)
+    else if(partitionIndex != partitionCount - 1){
+      accountOwners[accountNumber] = partitionCount - 1;
+    }
+    else {
+      int64_t slot = accountPool->addAccount(accountNumber, initBalance);
+      if(slot == -1){
+        dbg_trace("Account Pool is full! Dropping account: " << accountNumber);
+      }
+      else {
+        accountList.push_back(accountNumber);
+        accountSlots.push_back(slot);
+      }
+    }
+  if(concurrentProducers == true){
+    pthread_rwlock_unlock(&dispatchLock);
+  }
+}
+
+/* Dispatch a line of the transfers: a transfer, or an account to open */
+static void dispatchLine(const char *line, size_t length, dispatcher_t &dispatcher, \
+  transferCoalescer_t *coalescer, parseStats_t &stats)
+{
+  if(line[0] == 'O'){
+    openAccount(line, length, dispatcher);
+    return;
+  }
+  lockDispatch();
+    dispatchTransfer(line, length, dispatcher, coalescer, stats);
+  unlockDispatch();
+  // (credits to other partitions go out in batches, not under the lock)
+  if(partitionCount > 1){
+    partitionLink.sendCredits();
+  }
+}
+
+/* Dispatch the transfer lines of a file (a transfer source, or a file sent
+   to the daemon); the other lines are skipped */
+static int64_t dispatchTransferFile(const char *fileName, dispatcher_t &dispatcher, \
+  parseStats_t &stats)
+{
+  inputReader_t reader;
+  const char *line = NULL;
+  size_t length = 0;
+  const transfOptions_t &options = *dispatcher.options;
+  transferCoalescer_t coalescer;
+  bool coalesce = (options.coalesceWindow > 0);
+  if(coalesce){
+    coalescer.init(options.coalesceWindow, (coalesceMode) options.coalesceMode);
+  }
+
+  if(reader.open(fileName) == FAIL){
+    return FAIL;
+  }
+  while(reader.getLine(&line, &length))
+  {
+    if(line[0] == 'T' || line[0] == 'S' || line[0] == 'O'){
+      int64_t lineStart = (dispatcher.trace != NULL) ? monotonicNs() : 0;
+      dispatchLine(line, length, dispatcher, coalesce ? &coalescer : NULL, stats);
+      if(dispatcher.trace != NULL){
+        traceStep(dispatcher.trace, TRACE_PARSE, lineStart, monotonicNs());
+      }
+    }
+  }
+  reader.close();
+  if(coalesce){
+    lockDispatch();
+      flushCoalescer(coalescer, dispatcher, stats.requests);
+    unlockDispatch();
+    stats.coalescedTransfers += coalescer.getInputCount();
+  }
+  return SUCCESS;
+}
+
+/* Producer thread: reads a transfer source into the worker queues */
+static void* producerThread(void *arg)
+{
+  producer_t *producer = (producer_t *) arg;
+  int64_t startNs = monotonicNs();
+  producer->status = dispatchTransferFile(producer->fileName, producer->dispatcher, \
+    producer->stats);
+  producer->elapsedNs = monotonicNs() - startNs;
+  return NULL;
+}
+
+/* Other threads dispatch along with the parser from now on */
+static void shareDispatch()
+{
+  pthread_rwlockattr_t attr;
+  pthread_rwlockattr_init(&attr);
+  // (a producer recovering a crashed worker must not wait behind the pushes)
+  pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+  pthread_rwlock_init(&dispatchLock, &attr);
+  pthread_rwlockattr_destroy(&attr);
+  concurrentProducers = true;
+}
+
+/* The parser is the only one dispatching again */
+static void unshareDispatch()
+{
+  concurrentProducers = false;
+  pthread_rwlock_destroy(&dispatchLock);
+}
+
+/* Start a producer for every transfer source; their round robins start
+   spread over the workers */
+static void startProducers(const dispatcher_t &parser, std::vector<producer_t> &producers)
+{
+  producers.resize(transferSources.size());
+  if(producers.empty()){
+    return;
+  }
+  shareDispatch();
+
+  int64_t sources = producers.size() + 1;
+  for(size_t k = 0; k < producers.size(); k++)
+  {
+    producer_t &producer = producers[k];
+    parseStats_t stats = { 0, 0, 0, 0, 0 };
+    producer.fileName = transferSources[k].c_str();
+    producer.dispatcher = parser;
+    producer.dispatcher.assignID = ((k + 1) * parser.NumberOfProcesses) / sources - 1;
+    producer.dispatcher.trace = producerTrace(k + 1);
+    producer.stats = stats;
+    producer.status = FAIL;
+    producer.started = (pthread_create(&producer.thread, NULL, producerThread, \
+      &producer) == 0);
+    if(producer.started == false){
+      dbg_trace("Failed to start the producer of " << producer.fileName << "; reading it inline");
+      producerThread(&producer);
+    }
+  }
+}
+
+/* Wait for the producers and add their counters to the parser's */
+static void joinProducers(std::vector<producer_t> &producers, parseStats_t &stats, \
+  const transfOptions_t &options)
+{
+  for(size_t k = 0; k < producers.size(); k++)
+  {
+    producer_t &producer = producers[k];
+    if(producer.started == true){
+      pthread_join(producer.thread, NULL);
+    }
+    if(producer.status == FAIL){
+      print_error("ERROR: Failed to read the transfer file " << producer.fileName);
+    }
+    stats.requests += producer.stats.requests;
+    stats.rejected += producer.stats.rejected;
+    stats.coalescedTransfers += producer.stats.coalescedTransfers;
+    if(options.stats == true){
+      print_error("Producer " << k + 1 << " (" << producer.fileName << "): " \
+        << producer.stats.requests << " request(s) in " << std::fixed \
+        << std::setprecision(3) << producer.elapsedNs / 1e6 << " ms");
+    }
+  }
+  if(producers.empty() == false){
+    unshareDispatch();
+  }
+}
+
+/* --partition: apply a credit a peer sent, from its clearing account here.
+   An account we don't have yet may be opened further down the input (the
+   last partition opens those): it is waited for until the parser is done */
+static bool applyPeerCredit(int64_t peer, int64_t account, int64_t amount)
+{
+  dispatcher_t &dispatcher = creditDispatchers[peer];
+  while(1)
+  {
+    bool parsed = __atomic_load_n(&partitionParsed, __ATOMIC_ACQUIRE);
+    int64_t slot = -1;
+    lockDispatch();
+      slot = dispatcher.accountPool->slotOf(account);
+      if(slot != -1){
+        EFTRequest_t credit = { -1, clearingSlots[peer], slot, amount, LANE_BULK, 0, 0, -1, -1 };
+        dispatchRequest(dispatcher, &credit);
+      }
+    unlockDispatch();
+    if(slot != -1 || parsed == true){
+      return (slot != -1);
+    }
+    usleep(100);
+  }
+}
+
+/* --partition: refund the debit of a credit a peer refused */
+static void refundPeerCredit(int64_t peer, int64_t account, int64_t amount)
+{
+  dispatcher_t &dispatcher = refundDispatchers[peer];
+  lockDispatch();
+    int64_t slot = dispatcher.accountPool->slotOf(account);
+    EFTRequest_t refund = { -1, clearingSlots[peer], slot, amount, LANE_BULK, 0, 0, -1, -1 };
+    dispatchRequest(dispatcher, &refund);
+  unlockDispatch();
+}
+
+/* --partition: connect to the other instances and start applying their
+   credits (and our refunds), each peer's on a round robin of its own */
+static void startPartition(const dispatcher_t &parser)
+{
+  shareDispatch();
+  for(int64_t peer = 0; peer < partitionCount; peer++)
+  {
+    dispatcher_t dispatcher = parser;
+    dispatcher.assignID = ((peer + 1) * parser.NumberOfProcesses) / partitionCount - 1;
+    dispatcher.trace = NULL;
+    creditDispatchers.push_back(dispatcher);
+    refundDispatchers.push_back(dispatcher);
+  }
+  if(partitionLink.open(partitionIndex, partitionCount, partitionDirectory, partitionToken, \
+     applyPeerCredit, refundPeerCredit) == false){
+    print_error("ERROR: partition " << partitionIndex << " failed to connect to its peers");
+    partitionLink.close();
+    askProcessesToExit(parser.processData, parser.NumberOfProcesses, -1);
+    exit(1);
+  }
+  partitionStartNs = monotonicNs();
+}
+
+/* --partition: the input is done; send the last credits, then wait for the
+   replies to ours and until the peers have sent us all of theirs */
+static void finishPartition(const dispatcher_t &parser)
+{
+  __atomic_store_n(&partitionParsed, true, __ATOMIC_RELEASE);
+  bool complete = partitionLink.finish();
+  partitionLink.close();
+  unshareDispatch();
+  if(complete == false){
+    print_error("ERROR: partition " << partitionIndex << " lost a peer; its balances are incomplete");
+    askProcessesToExit(parser.processData, parser.NumberOfProcesses, parser.assignID);
+    exit(1);
+  }
+}
 
 /* Parse the input file into bank account pool and EFT requests pool */
 static int64_t assignWorkers(const char *fileName, processData_t **processData, \
-  bankAccountPool_t *accountPool, int64_t NumberOfProcesses, int64_t &requestCount)
-{
-  // Input file stream & buffer
-  std::ifstream fileStream;
-  std::stringstream stringParser;
-  char line[LINE_BUFFER] = { 0 };
-  int64_t accountNumber = -1, initBalance = 0;
-  int64_t fromAccount = -1, toAccount = -1, transferAmount = 0;
-  std::string transferString;
+  bankAccountPool_t *accountPool, int64_t NumberOfProcesses, \
+  const transfOptions_t &options, parseStats_t &stats)
+{
+  // Input reader (on its own thread) & buffer
+  inputReader_t reader;
+  const char *line = NULL;
+  size_t length = 0;
   bool initDone = false;
-  int64_t assignID = -1;
+  bool sequential = (options.engineMode == ENGINE_SEQUENTIAL);
+  dispatcher_t dispatcher = { processData, NumberOfProcesses, -1, accountPool, \
+    sequential, 0, options.stats, &options, producerTrace(0) };
+  // Producers of the other transfer sources (started with the transfers)
+  std::vector<producer_t> producers;
+  // Accounts are collected here and loaded once the transfers start
+  std::vector<accountRecord_t> accountRecords;
+  // Optional netting of the transfers before they are dispatched
+  transferCoalescer_t coalescer;
+  bool coalesce = (options.coalesceWindow > 0);
+  if(coalesce){
+    coalescer.init(options.coalesceWindow, (coalesceMode) options.coalesceMode);
+  }
 
-  // Open the fileStream
-  fileStream.open(fileName, std::ifstream::in);
-  if(!fileStream.is_open()){
-    dbg_trace("Failed to open the file: " << fileName);
+  // Start reading the input
+  if(reader.open(fileName) == FAIL){
     return FAIL;
   }
-  // Read from the file
-  while(fileStream.good())
+  // Parse it line by line while the reader fills the next buffers
+  bool poolInitDone = false;
+  while(reader.getLine(&line, &length))
   {
-    fileStream.getline(line, LINE_BUFFER);          // read a line
     dbg_trace("String: " << line);
 
     // Process spawn logic
-    static bool poolInitDone = false;
     if(poolInitDone == false){
       poolInitDone = true;
-      // InitPoolSpace here
-      int64_t maxAccounts = atoi(line);
-      if(maxAccounts < 1){
-        dbg_trace("Error! First line should be max number of accounts");
-        exit(1);
+      // InitPoolSpace here; the first line may declare the number of
+      // accounts (a number on its own), else it is the first record. The
+      // pool grows as accounts are added either way.
+      int64_t fields[2] = { 0, 0 };
+      bool declared = (parseLineFields(line, length, false, fields, 2) == 1);
+      int64_t maxAccounts = declared ? std::max<int64_t>(fields[0], 0) : 0;
+      if(options.shmName != NULL){
+        std::string poolSegment = sharedSegmentName(options.shmName, POOL_SEGMENT_SUFFIX);
+        accountPool->initPool(maxAccounts, options.hugePages, poolSegment.c_str());
+      }
+      else {
+        accountPool->initPool(maxAccounts, options.hugePages);
       }
-      accountPool->initPool(maxAccounts);
 
-      // Spawn processes
-      bool status = spawnProcesses(processData, accountPool, NumberOfProcesses);
-      if(status == FAIL){
-        dbg_trace("Failed to create processs!");
-        return 0;
+      // Spawn processes (the sequential engine has none)
+      if(sequential == false){
+        int64_t spawnStart = monotonicNs();
+        bool status = spawnProcesses(processData, accountPool, NumberOfProcesses, \
+          options);
+        if(status == FAIL){
+          dbg_trace("Failed to create processs!");
+          return 0;
+        }
+        stats.spawnNs = monotonicNs() - spawnStart;
       }
       // clear and repeat the sequence
       dbg_trace("*** POOL INIT DONE! THIS SHOULD NEVER PRINT AGAIN!!! ****");
-      goto CLEAR;
+      if(declared == true){
+        continue;
+      }
     }
 
+    int64_t lineStart = (dispatcher.trace != NULL) ? monotonicNs() : 0;
     // Check if the transfer requests are coming
-    if (isalpha(line[0]) && line[0]=='T' ){
+    if (isalpha(line[0]) && (line[0]=='T' || line[0]=='S') && !initDone){
       initDone = true;
+      loadAccounts(accountPool, accountRecords);
+      if(sharedState != NULL){
+        sharedState->stage = STAGE_TRANSFERS;
+      }
+      if(sequential == false){
+        startProducers(dispatcher, producers);
+      }
+      if(partitionCount > 1){
+        startPartition(dispatcher);
+      }
     }
-    stringParser.str(line);            // convert c-like string to stringParser
 
     // If we're not done reading accounts yet, keep reading and add to accountPool
     if(!initDone)
     {
-      stringParser >> accountNumber >> initBalance;
+      // "<accountNumber> <initBalance>" (or "Open <accountNumber> <initBalance>")
+      int64_t fields[2] = { -1, 0 };
+      parseLineFields(line, length, line[0] == 'O', fields, 2);
+      int64_t accountNumber = fields[0], initBalance = fields[1];
       dbg_trace("Account Number: " \
       << accountNumber << " , " << "Init Balance: " << initBalance);
 
       if(accountNumber == -1){
-        goto CLEAR;
+        continue;
       }
 
-      // Keep the order of the accounts
-      accountList.push_back(accountNumber);
-      // Adding the object to the map here
-      accountPool->addAccount(accountNumber, initBalance);
-
-      /*dbg_trace("POOL: \
-      Account Number: " << accountPool->at(accountNumber)->getAccountNumber() \
-      << " , " << \
-      "Init Balance: " << accountPool->at(accountNumber)->getBalance());*/
+      // Keep the order of the accounts; they're added to the pool in bulk
+      accountRecord_t record = { accountNumber, initBalance };
+      accountRecords.push_back(record);
     }
     else
     {
       // Once we are done reading accounts; read EFT requests
-      stringParser >> transferString >> fromAccount >> toAccount >> transferAmount;
-      dbg_trace("From: " << fromAccount << \
-      " To: " << toAccount << " Amount: " << transferAmount);
-
-      // Stop reading once we've reached invalid accounts i.e. EOF
-      if(fromAccount == -1 || toAccount == -1){
-        goto CLEAR;
+      dispatchLine(line, length, dispatcher, coalesce ? &coalescer : NULL, stats);
+    }
+    if(dispatcher.trace != NULL){
+      traceStep(dispatcher.trace, TRACE_PARSE, lineStart, monotonicNs());
+    }
+  }
+  // Empty input
+  if(poolInitDone == false){
+    dbg_trace("Error! The input is empty");
+    exit(1);
+  }
+  // Input without any transfers
+  if(!initDone){
+    loadAccounts(accountPool, accountRecords);
+    if(sequential == false){
+      startProducers(dispatcher, producers);
+    }
+    if(partitionCount > 1){
+      startPartition(dispatcher);
+    }
+  }
+  // Whatever is left in the last window
+  if(coalesce){
+    lockDispatch();
+      flushCoalescer(coalescer, dispatcher, stats.requests);
+    unlockDispatch();
+    stats.coalescedTransfers = coalescer.getInputCount();
+  }
+  // The other transfer sources: one after the other on the sequential
+  // engine, else wait for their producers
+  if(sequential == true){
+    for(size_t k = 0; k < transferSources.size(); k++){
+      if(dispatchTransferFile(transferSources[k].c_str(), dispatcher, stats) == FAIL){
+        print_error("ERROR: Failed to read the transfer file " << transferSources[k]);
       }
-
-      // Assign the job to next worker
-      assignID = (assignID + 1) % NumberOfProcesses;
-      ++requestCount;
-
-      assert(processData[assignID]->processID == assignID);    // Sanity checks
-      assert(processData[assignID]->processID \
-        == processData[assignID]->EFTRequests.getWorkerID());
-
-      // Create new EFT request
-      EFTRequest_t newRequest;
-      newRequest.workerID = assignID;
-      newRequest.fromAccount = fromAccount;
-      newRequest.toAccount = toAccount;
-      newRequest.transferAmount = transferAmount;
-
-      // Start writing;
-      // NOTE:: this is data-race safe since the workerQueue class implements
-      // safe IPC using mutex and condition varibales
-      processData[assignID]->EFTRequests.pushRequest(&newRequest);
-
-      /*dbg_trace("[Thread ID: " << processData[assignID]->processID << ","\
-      << "Job Assigned ID: " << assignID << ","\
-      << "Queue ID: " << processData[assignID]->EFTRequests.getWorkerID() << "]");*/
-    }
-
-CLEAR:
-    // Clear the buffer here, before reading the next line
-    memset(line, '\0', LINE_BUFFER);
-    stringParser.str("");       // Clear the stringstream
-    stringParser.clear();       // needed to clear the stringstream
-    accountNumber = fromAccount = toAccount = -1;
-    initBalance = transferAmount = 0;
-  }
-  // Check why we got out
-  if(fileStream.eof())
-  {
-    dbg_trace("Reached End-of-File!");
-    dbg_trace("Total Transfer Requests: " << requestCount);
-    // Ask all processs to terminate
-    askProcessesToExit(processData, NumberOfProcesses, assignID);
+    }
   }
-  else {
-    dbg_trace("Error while reading!");
-    //fileStream.close();
-    //return FAIL;
+  joinProducers(producers, stats, options);
+  if(partitionCount > 1){
+    finishPartition(dispatcher);
+  }
+  stats.firstCommitNs = dispatcher.firstCommitNs;
+  dbg_trace("Reached End-of-File!");
+  dbg_trace("Total Transfer Requests: " << stats.requests);
+  // Ask all processs to terminate (the daemon mode keeps them for later)
+  if(sequential == false && options.daemonSocket == NULL){
+    askProcessesToExit(processData, NumberOfProcesses, dispatcher.assignID);
   }
-  // Close the fileStream
-  fileStream.close();
+  // Stop the reader
+  reader.close();
 
   return SUCCESS;
 }
@@ -181,60 +880,630 @@ static void displayAccountPool(bankAccountPool_t *accountPool)
 }
 
 
-/* Print the account and their balances to stdout */
-static void printAccounts(bankAccountPool_t *accountPool)
+/* Print the account and their balances to stdout (or the output file) */
+static void printAccounts(bankAccountPool_t *accountPool, \
+  const transfOptions_t &options)
+{
+  int64_t status = writeBalances(accountPool, accountList, accountSlots, \
+    options.outputPath, options.outputThreads);
+  if(status == FAIL){
+    print_output("ERROR: Failed to write the account balances!");
+  }
+}
+
+/* Wait until the workers have applied every request dispatched to them
+   (recovering the ones that crash meanwhile) */
+static void waitForWorkers(processData_t **processData, int64_t NumberOfProcesses, \
+  const transfOptions_t &options)
+{
+  for(int64_t i = 0; i < NumberOfProcesses; i++){
+    for(int64_t polls = 1; __atomic_load_n(&processData[i]->stats.transfers, \
+        __ATOMIC_ACQUIRE) < processData[i]->dispatched; polls++){
+      usleep(50);
+      if(polls % (QUEUE_PUSH_TIMEOUT_MS * 20) == 0){
+        reapWorkers(processData, NumberOfProcesses, options, false);
+      }
+    }
+  }
+}
+
+/* Dispatch the transfer lines of a file to the running workers (daemon
+   mode) and wait until they are all applied */
+static int64_t applyTransferFile(const char *fileName, processData_t **processData, \
+  bankAccountPool_t *accountPool, int64_t NumberOfProcesses, \
+  const transfOptions_t &options, parseStats_t &stats)
+{
+  bool sequential = (options.engineMode == ENGINE_SEQUENTIAL);
+  dispatcher_t dispatcher = { processData, NumberOfProcesses, -1, accountPool, \
+    sequential, 0, options.stats, &options, producerTrace(0) };
+
+  // Only transfer lines; the accounts are already in the pool
+  if(dispatchTransferFile(fileName, dispatcher, stats) == FAIL){
+    return FAIL;
+  }
+  if(sequential == false){
+    waitForWorkers(processData, NumberOfProcesses, options);
+  }
+  return SUCCESS;
+}
+
+/* Daemon mode: with the accounts loaded and the workers running, apply the
+   transfer files sent over the control socket until told to quit. A command
+   is "<transfer-file> [<balances-file>]" or "quit"; after each file the
+   balances go to <balances-file> (or --output, or stdout). FAIL if the
+   control socket couldn't be opened. */
+static int64_t serveTransferFiles(processData_t **processData, \
+  bankAccountPool_t *accountPool, int64_t NumberOfProcesses, \
+  const transfOptions_t &options)
+{
+  int controlSocket = openControlSocket(options.daemonSocket);
+  if(controlSocket < 0){
+    return FAIL;
+  }
+  daemonControlSocket = controlSocket;
+  print_error("Serving transfer files on " << options.daemonSocket);
+  while(1)
+  {
+    std::string command;
+    int client = acceptCommand(controlSocket, command);
+    if(client < 0){
+      continue;
+    }
+    std::stringstream commandParser(command);
+    std::string fileName, balancesPath;
+    commandParser >> fileName >> balancesPath;
+    if(fileName == "quit"){
+      replyCommand(client, "bye");
+      break;
+    }
+    if(fileName.empty()){
+      replyCommand(client, "error: expected <transfer-file> [<balances-file>] or quit");
+      continue;
+    }
+
+    int64_t startNs = monotonicNs();
+    parseStats_t stats = { 0, 0, 0, 0, 0 };
+    if(applyTransferFile(fileName.c_str(), processData, accountPool, \
+       NumberOfProcesses, options, stats) == FAIL){
+      replyCommand(client, "error: failed to read " + fileName);
+      continue;
+    }
+    int64_t appliedNs = monotonicNs();
+
+    // Balances after this file
+    transfOptions_t snapshot = options;
+    if(balancesPath.empty() == false){
+      snapshot.outputPath = balancesPath.c_str();
+    }
+    printAccounts(accountPool, snapshot);
+
+    std::stringstream reply;
+    reply << "ok " << stats.requests << " request(s), " << stats.rejected \
+      << " rejected, applied in " << std::fixed << std::setprecision(3) \
+      << (appliedNs - startNs) / 1e6 << " ms";
+    if(options.stats == true){
+      print_error(fileName << ": " << reply.str().substr(3));
+    }
+    replyCommand(client, reply.str());
+  }
+  closeControlSocket(controlSocket, options.daemonSocket);
+  daemonControlSocket = -1;
+  return SUCCESS;
+}
+
+/* Close and remove the run's sockets and named segments when exiting on a
+   fatal error (main()'s teardown is skipped) */
+void removeRunFiles(const transfOptions_t &options)
+{
+  if(daemonControlSocket >= 0){
+    closeControlSocket(daemonControlSocket, options.daemonSocket);
+    daemonControlSocket = -1;
+  }
+  // (open once partitionStartNs is set)
+  if(partitionCount > 1 && partitionStartNs != 0){
+    partitionLink.close();
+  }
+  if(sharedState != NULL){
+    shm_unlink(sharedSegmentName(options.shmName).c_str());
+    shm_unlink(sharedSegmentName(options.shmName, POOL_SEGMENT_SUFFIX).c_str());
+  }
+}
+
+/* Report the startup times (--stats) to stderr */
+static void printStartupStats(const parseStats_t &parseStats, int64_t firstCommitNs, \
+  int64_t NumberOfProcesses)
+{
+  if(parseStats.spawnNs > 0){
+    print_error("Spawned " << NumberOfProcesses << " worker(s) in " << std::fixed \
+      << std::setprecision(3) << parseStats.spawnNs / 1e6 << " ms");
+  }
+  if(firstCommitNs > 0){
+    print_error("Time to first committed transfer: " << std::fixed \
+      << std::setprecision(3) << (firstCommitNs - programStartNs) / 1e6 << " ms");
+  }
+}
+
+/* Report the counters of the workers (--stats) to stderr; returns the time of
+   the first committed transfer */
+static int64_t printEngineStats(processData_t **processData, int64_t NumberOfProcesses)
+{
+  workerStats_t total;
+  memset(&total, 0, sizeof(total));
+  for(int64_t i = 0; i < NumberOfProcesses; i++){
+    total.transfers += processData[i]->stats.transfers;
+    total.contendedLocks += processData[i]->stats.contendedLocks;
+    total.groups += processData[i]->stats.groups;
+    total.turnWaits += processData[i]->stats.turnWaits;
+    for(int lane = 0; lane < QUEUE_LANES; lane++){
+      total.laneRequests[lane] += processData[i]->stats.laneRequests[lane];
+      total.laneLatencyNs[lane] += processData[i]->stats.laneLatencyNs[lane];
+      total.laneMaxLatencyNs[lane] = std::max(total.laneMaxLatencyNs[lane], \
+        processData[i]->stats.laneMaxLatencyNs[lane]);
+    }
+    int64_t firstCommitNs = processData[i]->stats.firstCommitNs;
+    if(firstCommitNs != 0 && (total.firstCommitNs == 0 || firstCommitNs < total.firstCommitNs)){
+      total.firstCommitNs = firstCommitNs;
+    }
+  }
+  print_error("Transfers applied: " << total.transfers \
+    << " , Contended locks: " << total.contendedLocks);
+  if(total.groups > 0){
+    print_error("Lock groups: " << total.groups << " , Avg group size: " \
+      << std::fixed << std::setprecision(2) \
+      << (double) total.transfers / total.groups);
+  }
+  if(total.turnWaits > 0){
+    print_error("Waited for their turn (--ordered): " << total.turnWaits << " transfer(s)");
+  }
+  const char *laneNames[QUEUE_LANES] = { "bulk", "urgent" };
+  for(int lane = 0; lane < QUEUE_LANES; lane++){
+    if(total.laneRequests[lane] == 0){
+      continue;
+    }
+    print_error("Lane " << laneNames[lane] << ": " << total.laneRequests[lane] \
+      << " request(s), latency mean " << std::fixed << std::setprecision(1) \
+      << total.laneLatencyNs[lane] / 1e3 / total.laneRequests[lane] << " us , max " \
+      << total.laneMaxLatencyNs[lane] / 1e3 << " us");
+  }
+  return total.firstCommitNs;
+}
+
+/* --partition: report what this instance applied, and the credits it
+   exchanged with each peer, to stderr. A clearing account holds what was
+   sent to the peer less what came from it; those of two peers add up to 0. */
+static void printPartitionStats(const parseStats_t &parseStats, bankAccountPool_t *accountPool)
+{
+  int64_t sent = 0, received = 0, applied = parseStats.requests;
+  for(int64_t peer = 0; peer < partitionCount; peer++)
+  {
+    const peerTraffic_t &traffic = partitionLink.getTraffic(peer);
+    sent += traffic.sent;
+    received += traffic.received;
+    applied += (traffic.received - traffic.declined) + traffic.refused;
+  }
+  double elapsedNs = std::max<int64_t>(monotonicNs() - partitionStartNs, 1);
+  print_error("Partition " << partitionIndex << "/" << partitionCount << ": " << applied \
+    << " request(s) applied in " << std::fixed << std::setprecision(3) << elapsedNs / 1e6 \
+    << " ms (" << std::setprecision(0) << applied / (elapsedNs / 1e9) << " per second); " \
+    << sent << " credit(s) sent to other partitions, " << received << " received");
+  for(int64_t peer = 0; peer < partitionCount; peer++)
+  {
+    if(peer == partitionIndex){
+      continue;
+    }
+    const peerTraffic_t &traffic = partitionLink.getTraffic(peer);
+    print_error("  partition " << peer << ": sent " << traffic.sent << " (amount " \
+      << traffic.sentAmount << ", " << traffic.refused << " refused), received " \
+      << traffic.received << " (amount " << traffic.receivedAmount << ", " \
+      << traffic.declined << " refused), clearing balance " \
+      << accountPool->atSlot(clearingSlots[peer])->getBalance());
+  }
+}
+
+/* Size of a regular file, or -1 (a pipe, or it can't be read) */
+static int64_t regularFileSize(const char *fileName)
+{
+  struct stat fileInfo;
+  if(stat(fileName, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode)){
+    return fileInfo.st_size;
+  }
+  return -1;
+}
+
+/* Pick the engine: the sequential engine for a single worker or for inputs
+   (all the sources together) too small to pay for forking the workers;
+   never for a partition nor a daemon, unless asked for */
+static int64_t resolveEngineMode(const transfOptions_t &options, const char *fileName, \
+  int64_t NumberOfProcesses)
+{
+  if(options.engineMode != ENGINE_AUTO){
+    return options.engineMode;
+  }
+  // (the peers' credits are applied by threads of their own, and the
+  // daemon's transfer files are sized after the accounts' input)
+  if(options.partitions > 1 || options.daemonSocket != NULL){
+    return ENGINE_PARALLEL;
+  }
+  if(NumberOfProcesses == 1){
+    return ENGINE_SEQUENTIAL;
+  }
+  int64_t inputSize = regularFileSize(fileName);
+  for(size_t k = 0; k < transferSources.size() && inputSize >= 0; k++){
+    int64_t sourceSize = regularFileSize(transferSources[k].c_str());
+    inputSize = (sourceSize < 0) ? -1 : inputSize + sourceSize;
+  }
+  if(inputSize >= 0 && inputSize < SEQUENTIAL_INPUT_SIZE){
+    return ENGINE_SEQUENTIAL;
+  }
+  return ENGINE_PARALLEL;
+}
+
+/* Worker count for "auto": one worker per online cpu but the parser's, cut
+   down while a sample of the input says the workers would mostly contend */
+static int64_t autoWorkerCount(const char *fileName)
 {
-  std::vector<int64_t>::iterator i;
-  for(i = accountList.begin(); i != accountList.end(); ++i)
+  int64_t cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int64_t maxWorkers = std::max<int64_t>(1, std::min<int64_t>(cpus - 1, MAX_WORKERS));
+  std::vector<transferPair_t> sample;
+  // (a pipe can't be sampled without taking the input away from the parser)
+  if(regularFileSize(fileName) >= 0){
+    sampleTransfers(fileName, AUTO_SAMPLE_TRANSFERS, sample);
+  }
+  // The transfers may all be in the other sources
+  if(sample.empty() && transferSources.empty() == false && \
+     regularFileSize(transferSources[0].c_str()) >= 0){
+    sampleTransfers(transferSources[0].c_str(), AUTO_SAMPLE_TRANSFERS, sample);
+  }
+  int64_t workers = recommendWorkers(sample, maxWorkers, AUTO_MAX_CONFLICT_RATE);
+  print_error("auto: " << workers << " worker(s) (" << cpus << " cpu(s), " \
+    << sample.size() << " sampled transfers)");
+  return workers;
+}
+
+/* Collect the transfer sources given after the worker count: a file, or a
+   directory standing for its (non hidden) regular files in name order */
+static int64_t collectTransferSources(int argc, char *argv[])
+{
+  for(int i = 3; i < argc; i++)
   {
-    print_output(*i << " " << accountPool->at((int64_t)(*i))->getBalance());
+    struct stat fileInfo;
+    if(stat(argv[i], &fileInfo) != 0 || access(argv[i], R_OK) != 0){
+      print_output("Failed to access the transfer file " << argv[i]);
+      return FAIL;
+    }
+    if(S_ISDIR(fileInfo.st_mode) == false){
+      transferSources.push_back(argv[i]);
+      continue;
+    }
+    DIR *directory = opendir(argv[i]);
+    if(directory == NULL){
+      print_output("Failed to read the directory " << argv[i]);
+      return FAIL;
+    }
+    std::vector<std::string> files;
+    struct dirent *entry = NULL;
+    while((entry = readdir(directory)) != NULL)
+    {
+      std::string path = std::string(argv[i]) + "/" + entry->d_name;
+      if(entry->d_name[0] != '.' && regularFileSize(path.c_str()) >= 0){
+        files.push_back(path);
+      }
+    }
+    closedir(directory);
+    std::sort(files.begin(), files.end());
+    transferSources.insert(transferSources.end(), files.begin(), files.end());
   }
+  return SUCCESS;
+}
+
+/* Print the usage */
+static void printUsage()
+{
+  print_output("USAGE:");
+  print_output("\t./transfProg <PathToInputFile|-> <NumberOfProcesses|auto> [<TransferFile|Dir>...]");
+  print_output("\t            [options]");
+  print_output("OPTIONS:");
+  print_output("\t--output <file>         write the balances to <file> instead of stdout");
+  print_output("\t--output-threads <n>    threads used to fill the output file (default 4)");
+  print_output("\t--coalesce <n>          net the transfers in windows of <n> before dispatch");
+  print_output("\t--coalesce-mode <m>     'pair' (net per account pair, default) or");
+  print_output("\t                        'account' (net per account)");
+  print_output("\t--reduce                workers accumulate private deltas and merge them");
+  print_output("\t                        into the pool at exit (no account locking)");
+  print_output("\t--batch <n>             apply up to <n> queued transfers under one ordered");
+  print_output("\t                        locking of their accounts (adapts to contention)");
+  print_output("\t--lock <type>           account lock: 'mutex' (default) or 'spin'");
+  print_output("\t--queue <type>          workers 'block' on their queue (default) or 'poll' it");
+  print_output("\t--stats                 count engine events and report them on stderr");
+  print_output("\t--mode <mode>           'parallel' workers, 'sequential' (no workers, no");
+  print_output("\t                        locks) or 'auto' (default: sequential for 1 worker");
+  print_output("\t                        or small inputs)");
+  print_output("\t--hugepages             back the queues and headers with huge pages (falls");
+  print_output("\t                        back to transparent huge page advice); the account");
+  print_output("\t                        pool only gets transparent huge page advice");
+  print_output("\t--shm-name <name>       keep the pool and worker state in named shared");
+  print_output("\t                        memory (/<name>, /<name>.pool) for eftInspect");
+  print_output("\t--daemon <socket>       after the input, keep the accounts and workers and");
+  print_output("\t                        apply the transfer files sent to the Unix socket");
+  print_output("\t                        (\"<transfer-file> [<balances-file>]\" or \"quit\")");
+  print_output("\t--parser <isa>          line parser: 'auto' (default: widest the cpu has,");
+  print_output("\t                        not necessarily the fastest; see eftBench),");
+  print_output("\t                        'avx2', 'sse4.2' or 'scalar'");
+  print_output("\t--inject-crash <w>:<n> kill worker <w> in the middle of its <n>-th transfer");
+  print_output("\t                        (to test the crash recovery)");
+  print_output("\t--trace <file.json>     record what the parser and workers spend their time");
+  print_output("\t                        on and write it as a Chrome trace-event file");
+  print_output("\t--ordered               apply the transfers on each account in input order");
+  print_output("\t                        (priorities are ignored)");
+  print_output("\t--partition <i>/<n>     run as instance <i> of <n>, each owning a range of");
+  print_output("\t                        the accounts and started on the same input");
+  print_output("\t--partition-dir <dir>   private directory of the run's sockets (required)");
 }
 
 // ------------------------ main() ------------------------------
-int main(int argc, char const *argv[])
+int main(int argc, char *argv[])
 {
+  programStartNs = monotonicNs();
+
+  // Parse the options first; they may appear anywhere on the command line
+  transfOptions_t options = { NULL, 4, 0, COALESCE_PAIR, false, 1, \
+    LOCK_MUTEX, QUEUE_BLOCKING, false, ENGINE_AUTO, false, NULL, NULL, PARSER_AUTO, -1, 0, \
+    NULL, false, 0, 1, NULL };
+  static struct option longOptions[] = {
+    { "output",         required_argument, NULL, 'o' },
+    { "output-threads", required_argument, NULL, 'j' },
+    { "coalesce",       required_argument, NULL, 'c' },
+    { "coalesce-mode",  required_argument, NULL, 'm' },
+    { "reduce",         no_argument,       NULL, 'r' },
+    { "batch",          required_argument, NULL, 'b' },
+    { "lock",           required_argument, NULL, 'l' },
+    { "queue",          required_argument, NULL, 'q' },
+    { "stats",          no_argument,       NULL, 's' },
+    { "mode",           required_argument, NULL, 'e' },
+    { "hugepages",      no_argument,       NULL, 'H' },
+    { "shm-name",       required_argument, NULL, 'n' },
+    { "daemon",         required_argument, NULL, 'D' },
+    { "parser",         required_argument, NULL, 'P' },
+    { "inject-crash",   required_argument, NULL, 'K' },
+    { "trace",          required_argument, NULL, 'T' },
+    { "ordered",        no_argument,       NULL, 'O' },
+    { "partition",      required_argument, NULL, 'p' },
+    { "partition-dir",  required_argument, NULL, 'd' },
+    { NULL, 0, NULL, 0 }
+  };
+  int opt = 0;
+  while((opt = getopt_long(argc, argv, "o:j:c:m:rb:l:q:se:Hn:D:P:K:T:Op:d:", longOptions, NULL)) != -1)
+  {
+    switch(opt){
+      case 'K':
+        if(sscanf(optarg, "%" SCNd64 ":%" SCNd64, &options.crashWorker, \
+           &options.crashTransfer) != 2 || options.crashTransfer < 1){
+          printUsage();
+          return 0;
+        }
+        break;
+      case 'T': options.tracePath = optarg; break;
+      case 'O': options.ordered = true; break;
+      case 'p':
+        if(sscanf(optarg, "%" SCNd64 "/%" SCNd64, &options.partition, \
+           &options.partitions) != 2 || options.partitions < 1 || \
+           options.partitions > MAX_PARTITIONS || options.partition < 0 || \
+           options.partition >= options.partitions){
+          printUsage();
+          return 0;
+        }
+        break;
+      case 'd': options.partitionDir = optarg; break;
+      case 'H': options.hugePages = true; break;
+      case 'n': options.shmName = optarg; break;
+      case 'D': options.daemonSocket = optarg; break;
+      case 'P':
+        if(strcmp(optarg, "auto") == 0){
+          options.lineParser = PARSER_AUTO;
+        }
+        else if(strcmp(optarg, "scalar") == 0){
+          options.lineParser = PARSER_SCALAR;
+        }
+        else if(strcmp(optarg, "sse4.2") == 0){
+          options.lineParser = PARSER_SSE42;
+        }
+        else if(strcmp(optarg, "avx2") == 0){
+          options.lineParser = PARSER_AVX2;
+        }
+        else {
+          printUsage();
+          return 0;
+        }
+        break;
+      case 'e':
+        if(strcmp(optarg, "auto") == 0){
+          options.engineMode = ENGINE_AUTO;
+        }
+        else if(strcmp(optarg, "parallel") == 0){
+          options.engineMode = ENGINE_PARALLEL;
+        }
+        else if(strcmp(optarg, "sequential") == 0){
+          options.engineMode = ENGINE_SEQUENTIAL;
+        }
+        else {
+          printUsage();
+          return 0;
+        }
+        break;
+      case 's': options.stats = true; break;
+      case 'l':
+        if(strcmp(optarg, "mutex") == 0){
+          options.lockPolicy = LOCK_MUTEX;
+        }
+        else if(strcmp(optarg, "spin") == 0){
+          options.lockPolicy = LOCK_SPIN;
+        }
+        else {
+          printUsage();
+          return 0;
+        }
+        break;
+      case 'q':
+        if(strcmp(optarg, "block") == 0){
+          options.queuePolicy = QUEUE_BLOCKING;
+        }
+        else if(strcmp(optarg, "poll") == 0){
+          options.queuePolicy = QUEUE_POLLING;
+        }
+        else {
+          printUsage();
+          return 0;
+        }
+        break;
+      case 'r': options.reduce = true; break;
+      case 'b': options.batchSize = atoll(optarg); break;
+      case 'o': options.outputPath = optarg; break;
+      case 'j': options.outputThreads = atoll(optarg); break;
+      case 'c': options.coalesceWindow = atoll(optarg); break;
+      case 'm':
+        if(strcmp(optarg, "pair") == 0){
+          options.coalesceMode = COALESCE_PAIR;
+        }
+        else if(strcmp(optarg, "account") == 0){
+          options.coalesceMode = COALESCE_ACCOUNT;
+        }
+        else {
+          printUsage();
+          return 0;
+        }
+        break;
+      default:
+        printUsage();
+        return 0;
+    }
+  }
+  argv += optind - 1;
+  argc -= optind - 1;
+
   // Check and parse the command line argument
-  if(argc != 3){
-    print_output("USAGE:");
-    print_output("\t./transfProg <PathToInputFile> <NumberOfProcesses>");
+  if(argc < 3){
+    printUsage();
     return 0;
   }
-  // Check the validity of the input file,
-  int64_t fileStatus = access(argv[1], F_OK | R_OK);
+  // Check the validity of the input file ("-" reads stdin),
+  int64_t fileStatus = (strcmp(argv[1], "-") == 0) ? 0 : access(argv[1], F_OK | R_OK);
   if(fileStatus != 0){
     print_output("Failed to access the input file or file doesn't exist!");
     print_output("Please check the path to the input file is correct.");
     return 0;
   }
+  // Any other transfer sources
+  if(collectTransferSources(argc, argv) == FAIL){
+    return 0;
+  }
   // Check the validity of the worker processs
-  int64_t workerProcesses = atoi((const char *) argv[2]);
+  int64_t workerProcesses = 0;
+  if(strcmp(argv[2], "auto") == 0){
+    workerProcesses = autoWorkerCount(argv[1]);
+  }
+  else {
+    workerProcesses = atoi((const char *) argv[2]);
+  }
   if(workerProcesses < 1 || workerProcesses > MAX_WORKERS){
     print_output("Invalid number of workers: " << workerProcesses \
      << "\nEnter buffer size between 1 to " << MAX_WORKERS);
     return 0;
   }
 
+  // --ordered needs every queue to hold its requests in input order, one
+  // transfer per request
+  if(options.ordered == true && (options.coalesceWindow > 0 || options.batchSize > 1 || \
+     options.reduce == true)){
+    print_output("--ordered can't be used with --coalesce, --batch or --reduce");
+    return 0;
+  }
+  if(options.ordered == true && transferSources.empty() == false){
+    print_output("--ordered takes the transfers from a single input");
+    return 0;
+  }
+
+  // The instances of a partitioned run all read the same (single) input
+  // and apply the peers' credits on their workers
+  if(options.partitions > 1 && (options.daemonSocket != NULL || options.ordered == true || \
+     options.engineMode == ENGINE_SEQUENTIAL || transferSources.empty() == false)){
+    print_output("--partition can't be used with --daemon, --ordered, --mode sequential" \
+      " or several input sources");
+    return 0;
+  }
+  if(options.partitions > 1 && options.partitionDir == NULL){
+    print_output("--partition needs --partition-dir, a directory private to the run");
+    return 0;
+  }
+  partitionIndex = options.partition;
+  partitionCount = options.partitions;
+  partitionDirectory = options.partitionDir;
+
+  // Reduction workers only merge their deltas when they exit
+  if(options.daemonSocket != NULL && options.reduce == true){
+    print_output("--reduce can't be used with --daemon");
+    return 0;
+  }
+
+  // Only the engines that keep in-flight records can be crashed on purpose
+  if(options.crashWorker >= 0 && crashTolerantEngine(options) == false){
+    print_error("WARNING: --inject-crash is ignored with --batch, --reduce and --lock spin");
+  }
+
+  // Vectorized line parser, if the cpu has one
+  int64_t lineParser = selectLineParser(options.lineParser);
+  dbg_trace("Line parser: " << lineParserName(lineParser));
+
+  // Counters for --stats have to be inherited by the workers
+  if(options.stats == true){
+    startMemoryCounters();
+  }
+
   // If everything is fine, map the shared memory and spawn workers
-  void *sAccontPool = mmap(NULL, sizeof(bankAccountPool_t), PROT_READ | PROT_WRITE, \
-            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-  if(sAccontPool == MAP_FAILED){
-    print_output("(main()) PID: " << getpid() << " , " \
-      "Failed to map the memory for bankAccountPool! *ABORT*");
-    exit(1);
+  size_t accountPoolSize = sizeof(bankAccountPool_t);
+  size_t processDataSize = sizeof(processData_t) * workerProcesses;
+  void *sAccontPool = NULL;
+  void *sProcessData = NULL;
+  size_t sharedStateBytes = 0;
+  if(options.shmName != NULL)
+  {
+    // One named control segment holds the pool header and the worker data
+    sharedStateBytes = sharedStateSize(workerProcesses);
+    std::string segment = sharedSegmentName(options.shmName);
+    void *sState = mapNamedSharedMemory(segment.c_str(), &sharedStateBytes, \
+      options.hugePages);
+    if(sState == NULL){
+      print_output("(main()) PID: " << getpid() << " , " \
+        "Failed to create the shared memory segment " << segment << "! *ABORT*");
+      exit(1);
+    }
+    sharedState = (sharedStateHeader_t *) sState;
+    sharedState->ownerPID = getpid();
+    sharedState->startNs = programStartNs;
+    sharedState->numberOfWorkers = workerProcesses;
+    sharedState->stage = STAGE_LOADING;
+    sAccontPool = (char *) sState + sharedPoolOffset();
+    sProcessData = (char *) sState + sharedProcessDataOffset();
+    __atomic_store_n(&sharedState->magic, SHARED_STATE_MAGIC, __ATOMIC_RELEASE);
+  }
+  else
+  {
+    sAccontPool = mapSharedMemory(&accountPoolSize, options.hugePages);
+    if(sAccontPool == NULL){
+      print_output("(main()) PID: " << getpid() << " , " \
+        "Failed to map the memory for bankAccountPool! *ABORT*");
+      exit(1);
+    }
+    // map processData memory here
+    sProcessData = mapSharedMemory(&processDataSize, options.hugePages);
+    if(sProcessData == NULL){
+      print_output("(main()) PID: " << getpid() << " , " \
+      "Failed to map the memory for processData! *ABORT*");
+      exit(1);
+    }
   }
   // Pool of bank accounts
   bankAccountPool_t *accountPool = (bankAccountPool_t *) sAccontPool;
 
-  // map processData memory here
-  void *sProcessData = mmap(NULL, sizeof(processData_t) * workerProcesses, \
-            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-  if(sProcessData == MAP_FAILED){
-    print_output("(main()) PID: " << getpid() << " , " \
-    "Failed to map the memory for processData! *ABORT*");
-    exit(1);
-  }
-
   // Pool of processData_t maintained by main()
   // this is needed because main will assign jobs to all EFTWorkers
   processData_t *processData[workerProcesses];
@@ -247,52 +1516,137 @@ int main(int argc, char const *argv[])
     processData[i] = sHandle;
   }
 
-  // Keep the EFT Transfer Request count
-  int64_t EFTRequestsCount = 0;
+  // Pick the engine before anything is spawned
+  options.engineMode = resolveEngineMode(options, argv[1], workerProcesses);
+  dbg_trace("Engine: " << (options.engineMode == ENGINE_SEQUENTIAL ? \
+    "sequential" : "parallel"));
+
+  // Timeline rings of the producers (the sequential engine reads all the
+  // sources on the parser) and the workers (--trace)
+  traceBuffer_t traceRings;
+  int64_t producers = (options.engineMode == ENGINE_SEQUENTIAL) ? 1 : \
+    1 + transferSources.size();
+  if(options.tracePath != NULL){
+    if(traceRings.init(producers, workerProcesses) == false){
+      print_output("(main()) PID: " << getpid() << " , " \
+        "Failed to map the memory for the trace! *ABORT*");
+      exit(1);
+    }
+    for(int64_t k = 0; k < producers; k++){
+      producerTraces.push_back(traceRings.ring(k));
+    }
+  }
+  for(int i = 0; i < workerProcesses; i++){
+    processData[i]->trace = producerTraces.empty() ? NULL : traceRings.ring(producers + i);
+  }
+
+  // Keep the EFT Transfer Request count (and the ones we could not process)
+  parseStats_t parseStats = { 0, 0, 0, 0, 0 };
 
   // And parse the file
   int64_t parseStatus = assignWorkers(argv[1], processData, accountPool, \
-    workerProcesses, EFTRequestsCount);
+    workerProcesses, options, parseStats);
   if(parseStatus == FAIL)
   {
     print_output("ERROR: Failed during parsing!");
     return 0;
   }
+  if(parseStats.rejected > 0){
+    print_error("WARNING: Rejected " << parseStats.rejected \
+      << " transfer(s) referring to unknown accounts (or with too many credits)");
+  }
+  if(options.coalesceWindow > 0){
+    print_error("Coalesced " << parseStats.coalescedTransfers << " transfer(s) into " \
+      << parseStats.requests << " request(s), ratio " << std::fixed \
+      << std::setprecision(2) << (double) parseStats.coalescedTransfers / \
+      std::max(parseStats.requests, (int64_t) 1) << ":1");
+  }
 
-  // wait for processes to finish
-  int pStatus = 0;
-  for(int i = 0; i < workerProcesses; i++)
-  {
-    wait(&pStatus);
-    if(WIFEXITED(pStatus)){
-      dbg_trace("PROCESS: " << i << " TERMINATED!");
+  // Keep serving transfer files until told to quit
+  int64_t daemonStatus = SUCCESS;
+  if(options.daemonSocket != NULL){
+    daemonStatus = serveTransferFiles(processData, accountPool, workerProcesses, options);
+    if(options.engineMode != ENGINE_SEQUENTIAL){
+      askProcessesToExit(processData, workerProcesses, -1);
     }
-    else if(pStatus == -1){
-      dbg_trace("Error! PROCESS: " << i << " Terminaton not successful!");
+  }
+
+  // wait for processes to finish (the sequential engine has already applied
+  // everything); a worker that crashed is recovered and respawned
+  if(options.engineMode != ENGINE_SEQUENTIAL)
+  {
+    for(int64_t exited = 0; exited < workerProcesses; ){
+      int64_t reaped = reapWorkers(processData, workerProcesses, options, true);
+      if(reaped < 0){
+        dbg_trace("Error! " << workerProcesses - exited << " process(es) lost!");
+        break;
+      }
+      exited += reaped;
     }
     // free up the worker resources
-    processData[i]->EFTRequests.destroy();
+    for(int i = 0; i < workerProcesses; i++){
+      processData[i]->EFTRequests.destroy();
+    }
+  }
+  if(sharedState != NULL){
+    sharedState->stage = STAGE_DONE;
+  }
+  if(options.stats == true && options.engineMode == ENGINE_SEQUENTIAL){
+    print_error("Transfers applied: " << parseStats.requests << " (sequential engine)");
+    printStartupStats(parseStats, parseStats.firstCommitNs, workerProcesses);
+  }
+  else if(options.stats == true){
+    int64_t firstCommitNs = printEngineStats(processData, workerProcesses);
+    printStartupStats(parseStats, firstCommitNs, workerProcesses);
+  }
+  if(options.stats == true){
+    reportMemoryCounters();
+  }
+  // Every process that wrote to the rings is gone
+  if(producerTraces.empty() == false){
+    int64_t events = traceRings.writeChromeTrace(options.tracePath, programStartNs, getpid());
+    if(events < 0){
+      print_error("ERROR: Failed to write the trace to " << options.tracePath);
+    }
+    else {
+      print_error("Trace: " << events << " event(s) written to " << options.tracePath \
+        << " (" << traceRings.getDropped() << " overwritten)");
+    }
+    traceRings.destroy();
+  }
+
+  if(partitionCount > 1){
+    printPartitionStats(parseStats, accountPool);
   }
 
   // Display the Accounts and their Balances after transfer
   displayAccountPool(accountPool);
-  printAccounts(accountPool);
+  printAccounts(accountPool, options);
 
   // destroy the accountPool
   accountPool->deInitPool();
 
-  // Unmap the memory
-  int ustatus = munmap(accountPool, sizeof(bankAccountPool_t));
-  if(ustatus != 0){
-    print_output("(main()) PID: " << getpid() << " , " \
-                 "Failed to unmap the accountPool memory! Exiting!");
+  // Unmap the memory (and remove the named segments)
+  if(sharedState != NULL)
+  {
+    munmap(sharedState, sharedStateBytes);
+    shm_unlink(sharedSegmentName(options.shmName).c_str());
+    shm_unlink(sharedSegmentName(options.shmName, POOL_SEGMENT_SUFFIX).c_str());
   }
+  else
+  {
+    int ustatus = munmap(accountPool, accountPoolSize);
+    if(ustatus != 0){
+      print_output("(main()) PID: " << getpid() << " , " \
+                   "Failed to unmap the accountPool memory! Exiting!");
+    }
 
-  ustatus = munmap(sProcessData, sizeof(processData_t) * workerProcesses);
-  if(ustatus != 0){
-    print_output("(main()) PID: " << getpid() << " , " \
-    "Failed to unmap the processData memory! Exiting!");
+    ustatus = munmap(sProcessData, processDataSize);
+    if(ustatus != 0){
+      print_output("(main()) PID: " << getpid() << " , " \
+      "Failed to unmap the processData memory! Exiting!");
+    }
   }
 
-  return 0;
+  return (daemonStatus == SUCCESS) ? 0 : 1;
 }
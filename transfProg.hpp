@@ -14,25 +14,117 @@
 #define __EFT_TRANSFER__
 
 
+#include <time.h>
+
 #include "bankAccount.hpp"
 #include "workerQueue.hpp"
+#include "eventTrace.hpp"
 #include "debugMacros.hpp"
 
 // Macros
-#define           LINE_BUFFER                   50
 #define           MAX_WORKERS                   10000
+// Inputs smaller than this run on the sequential engine in auto mode
+#define           SEQUENTIAL_INPUT_SIZE         (64 * 1024)
+// Above this many workers, helper processes fork them in parallel
+#define           SPAWN_FANOUT_THRESHOLD        64
+#define           SPAWN_PER_HELPER              64
+// A push blocked this long makes the parent check for crashed workers
+#define           QUEUE_PUSH_TIMEOUT_MS         100
+
+// Engine policies selectable from the command line
+enum lockPolicyType {
+  LOCK_MUTEX = 0,                           // process shared pthread mutex
+  LOCK_SPIN = 1                             // spin lock in the account
+};
+enum queuePolicyType {
+  QUEUE_BLOCKING = 0,                       // sleep on the queue semaphore
+  QUEUE_POLLING = 1                         // poll the queue before sleeping
+};
+
+enum engineModeType {
+  ENGINE_AUTO = 0,                          // pick one from the input
+  ENGINE_PARALLEL = 1,                      // forked workers
+  ENGINE_SEQUENTIAL = 2                     // apply in the parser; no fork, no locks
+};
+
+// Command line options of transfProg
+typedef struct transfOptions {
+  const char *outputPath;                   // balances go to stdout when NULL
+  int64_t outputThreads;                    // threads filling the output file
+  int64_t coalesceWindow;                   // transfers netted together (0: off)
+  int64_t coalesceMode;                     // coalesceMode of the netting
+  bool reduce;                              // workers accumulate deltas, merge at exit
+  int64_t batchSize;                        // max requests applied under one locking
+  int64_t lockPolicy;                       // lockPolicyType of the engine
+  int64_t queuePolicy;                      // queuePolicyType of the engine
+  bool stats;                               // count and report engine events
+  int64_t engineMode;                       // engineModeType
+  bool hugePages;                           // back the shared mappings with huge pages
+  const char *shmName;                      // named shared memory (NULL: anonymous)
+  const char *daemonSocket;                 // keep serving transfer files (NULL: off)
+  int64_t lineParser;                       // lineParserType of the input parser
+  int64_t crashWorker;                      // --inject-crash: worker to kill (-1: none)
+  int64_t crashTransfer;                    // in the middle of its n-th transfer
+  const char *tracePath;                    // timeline of the run, as JSON (NULL: off)
+  bool ordered;                             // apply each account's transfers in input order
+  int64_t partition;                        // --partition: this instance's range of the accounts
+  int64_t partitions;                       // and the number of instances (1: not partitioned)
+  const char *partitionDir;                 // where the instances' sockets are (private)
+} transfOptions_t;
+
+// Counters kept while parsing the input
+typedef struct parseStats {
+  int64_t requests;                         // requests dispatched to the workers
+  int64_t rejected;                         // transfers with unknown accounts
+  int64_t coalescedTransfers;               // transfers fed to the coalescer
+  int64_t spawnNs;                          // time taken to spawn the workers
+  int64_t firstCommitNs;                    // first transfer applied (sequential engine)
+} parseStats_t;
+
+// Counters of a worker (only filled in when instrumentation is on)
+typedef struct workerStats {
+  int64_t transfers;                        // transfers applied
+  int64_t contendedLocks;                   // locks found already taken
+  int64_t groups;                           // lock groups applied (--batch)
+  int64_t turnWaits;                        // transfers that waited for their turn (--ordered)
+  int64_t firstCommitNs;                    // when the first transfer was applied
+  int64_t laneRequests[QUEUE_LANES];        // timed requests applied, per lane
+  int64_t laneLatencyNs[QUEUE_LANES];       // sum of their push-to-apply latencies
+  int64_t laneMaxLatencyNs[QUEUE_LANES];    // and the largest one
+} workerStats_t;
 
 // Process Data
 typedef struct processData {
   int64_t processID;                             // Each process has it's own ID
   workerQueue_t EFTRequests;                // Each process has it's own queue
   bankAccountPool_t *accountPool;           // Each process has access to common account pool
+  workerStats_t stats;                      // Written by the worker only
+  int64_t dispatched;                       // requests pushed (written by the parser only)
+  int64_t pid;                              // process running the worker
+  inflightRecord_t inflight;                // request being applied (crash recovery)
+  int64_t injectCrashAt;                    // transfer to die in (--inject-crash; 0: never)
+  traceRing_t *trace;                       // timeline events (--trace; NULL: off)
 } processData_t;
 
+// Monotonic clock in nanoseconds (comparable across the forked workers)
+inline int64_t monotonicNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 // Functions for managing processes
 int64_t spawnProcesses(processData_t **processDataPool, \
-  bankAccountPool_t *accountPool, int64_t NumberOfProcesses);
+  bankAccountPool_t *accountPool, int64_t NumberOfProcesses, \
+  const transfOptions_t &options);
 void askProcessesToExit(processData_t **processData, int64_t NumberOfProcesses, \
   int64_t lastAssignedID);
+int64_t reapWorkers(processData_t **processData, int64_t NumberOfProcesses, \
+  const transfOptions_t &options, bool block);
+// Closes and removes what the run keeps in the file system (the named shared
+// memory segments, the daemon's and the partition's sockets), for the exits
+// that skip the end of main()
+void removeRunFiles(const transfOptions_t &options);
 
 #endif
@@ -0,0 +1,139 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T11:30:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: transferCoalescer.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T11:30:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <vector>
+#include <algorithm>
+
+#include "debugMacros.hpp"
+#include "transferCoalescer.hpp"
+
+// Std namespace
+using namespace std;
+
+
+static inline EFTRequest_t netRequest(int64_t fromSlot, int64_t toSlot, int64_t amount)
+{
+  EFTRequest_t request = { -1, fromSlot, toSlot, amount, LANE_BULK, 0, 0, -1, -1 };
+  return request;
+}
+
+// ------------------------ Class: transferCoalescer ------------------------------
+
+void transferCoalescer :: init(int64_t windowSize, coalesceMode netMode)
+{
+  this->window = (windowSize < 1) ? 1 : windowSize;
+  this->mode = netMode;
+  this->pending = 0;
+  this->net.clear();
+  this->net.reserve(this->window);
+  this->order.clear();
+  this->inputCount = 0;
+  this->outputCount = 0;
+}
+
+// Adds a transfer to the current window; returns true once the window is full
+bool transferCoalescer :: addTransfer(int64_t fromSlot, int64_t toSlot, int64_t amount)
+{
+  ++this->inputCount;
+  ++this->pending;
+
+  if(this->mode == COALESCE_PAIR)
+  {
+    // a -> b of x is the same as b -> a of -x
+    slotPair_t key = (fromSlot < toSlot) ? slotPair_t(fromSlot, toSlot) \
+                                         : slotPair_t(toSlot, fromSlot);
+    int64_t signedAmount = (fromSlot < toSlot) ? amount : -amount;
+    std::pair<std::unordered_map<slotPair_t, int64_t, slotPairHash>::iterator, bool> entry = \
+      this->net.insert(std::make_pair(key, signedAmount));
+    if(entry.second == true){
+      this->order.push_back(key);
+    }
+    else {
+      entry.first->second += signedAmount;
+    }
+  }
+  else
+  {
+    int64_t slots[2] = { fromSlot, toSlot };
+    int64_t deltas[2] = { -amount, amount };
+    for(int i = 0; i < 2; i++){
+      slotPair_t key(slots[i], slots[i]);
+      std::pair<std::unordered_map<slotPair_t, int64_t, slotPairHash>::iterator, bool> entry = \
+        this->net.insert(std::make_pair(key, deltas[i]));
+      if(entry.second == true){
+        this->order.push_back(key);
+      }
+      else {
+        entry.first->second += deltas[i];
+      }
+    }
+  }
+  return this->pending >= this->window;
+}
+
+// Appends the net requests of the current window and starts a new window
+void transferCoalescer :: flush(std::vector<EFTRequest_t> &requests)
+{
+  size_t firstRequest = requests.size();
+  if(this->mode == COALESCE_PAIR)
+  {
+    for(size_t i = 0; i < this->order.size(); i++){
+      int64_t amount = this->net[this->order[i]];
+      if(amount == 0){
+        continue;
+      }
+      requests.push_back(netRequest(this->order[i].first, this->order[i].second, amount));
+      ++this->outputCount;
+    }
+  }
+  else
+  {
+    // Deltas sum to zero: settle every debtor against the creditors in turn,
+    // which needs less transfers than there are accounts in the window
+    std::vector<std::pair<int64_t, int64_t> > debtors, creditors;
+    for(size_t i = 0; i < this->order.size(); i++){
+      int64_t delta = this->net[this->order[i]];
+      if(delta < 0){
+        debtors.push_back(std::make_pair(this->order[i].first, -delta));
+      }
+      else if(delta > 0){
+        creditors.push_back(std::make_pair(this->order[i].first, delta));
+      }
+    }
+    size_t d = 0, c = 0;
+    while(d < debtors.size() && c < creditors.size()){
+      int64_t amount = std::min(debtors[d].second, creditors[c].second);
+      requests.push_back(netRequest(debtors[d].first, creditors[c].first, amount));
+      ++this->outputCount;
+      debtors[d].second -= amount;
+      creditors[c].second -= amount;
+      if(debtors[d].second == 0) ++d;
+      if(creditors[c].second == 0) ++c;
+    }
+  }
+
+  dbg_trace("Coalesced window of " << this->pending << " transfers into " \
+    << (requests.size() - firstRequest) << " requests");
+  this->pending = 0;
+  this->net.clear();
+  this->order.clear();
+}
+
+// retrieves the number of transfers added
+int64_t transferCoalescer :: getInputCount(){
+  return this->inputCount;
+}
+
+// retrieves the number of net requests produced
+int64_t transferCoalescer :: getOutputCount(){
+  return this->outputCount;
+}
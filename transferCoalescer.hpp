@@ -0,0 +1,68 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T11:30:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: transferCoalescer.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T11:30:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __TRANSFER_COALESCER__
+#define __TRANSFER_COALESCER__
+
+
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "workerQueue.hpp"
+
+// -- Typedefs --
+typedef class transferCoalescer transferCoalescer_t;
+// (lower slot, higher slot) of a pair; (slot, slot) of an account
+typedef std::pair<int64_t, int64_t> slotPair_t;
+
+// Hash of a slotPair_t (slots are not bounded, so the pair isn't packed
+// into a single word)
+struct slotPairHash {
+  size_t operator()(const slotPair_t &key) const {
+    return std::hash<uint64_t>()(((uint64_t) key.first * 0x9e3779b97f4a7c15ULL) ^ \
+      (uint64_t) key.second);
+  }
+};
+
+// How transfers inside a window are netted
+enum coalesceMode {
+  COALESCE_PAIR = 0,        // one net transfer per pair of accounts
+  COALESCE_ACCOUNT = 1      // one net delta per account, settled with transfers
+};
+
+// -- Classes --
+// Accumulates transfers over a window and nets them; since the final balances
+// only depend on each account's net delta, only the net adjustments need to
+// be dispatched to the workers.
+class transferCoalescer
+{
+private:
+  int64_t window;                               // transfers per window
+  coalesceMode mode;
+  int64_t pending;                              // transfers in current window
+  std::unordered_map<slotPair_t, int64_t, slotPairHash> net;  // pair or account -> net amount
+  std::vector<slotPair_t> order;                // keys in first-seen order
+  int64_t inputCount;                           // transfers added so far
+  int64_t outputCount;                          // requests produced so far
+
+public:
+  void init(int64_t windowSize, coalesceMode netMode);
+  bool addTransfer(int64_t fromSlot, int64_t toSlot, int64_t amount);  // true when window is full
+  void flush(std::vector<EFTRequest_t> &requests);  // net requests of the window
+  int64_t getInputCount();
+  int64_t getOutputCount();
+};
+
+
+#endif
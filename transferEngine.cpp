@@ -0,0 +1,73 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T13:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: transferEngine.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T13:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include "transferEngine.hpp"
+
+// Std namespace
+using namespace std;
+
+// The combinations of policies built into transfProg. Building with
+// -DENGINE_DEFAULT_ONLY (see ENGINE_FLAGS in the Makefile) keeps only the
+// mutex + blocking queue engines and makes the other options fall back to it.
+
+// Picks the worker variant (transfer/batch/reduce) for fixed policies
+// (--ordered only goes with the transfer worker; see main())
+template <class lockPolicy, class queuePolicy, class statsPolicy>
+static EFTWorkerFunc_t selectStrategy(const transfOptions_t &options)
+{
+  if(options.ordered == true){
+    return EFTTransferWorker<lockPolicy, queuePolicy, slotLookup, statsPolicy, inputOrder>;
+  }
+  if(options.reduce == true){
+    return EFTReduceWorker<queuePolicy, slotLookup, statsPolicy>;
+  }
+  if(options.batchSize > 1){
+    return EFTBatchWorker<lockPolicy, queuePolicy, slotLookup, statsPolicy>;
+  }
+  return EFTTransferWorker<lockPolicy, queuePolicy, slotLookup, statsPolicy>;
+}
+
+template <class lockPolicy, class queuePolicy>
+static EFTWorkerFunc_t selectStats(const transfOptions_t &options)
+{
+  if(options.tracePath != NULL){
+    return selectStrategy<lockPolicy, queuePolicy, tracingStats>(options);
+  }
+  // (an inspector attached to --shm-name reads the counters too, and the
+  // daemon mode waits on them)
+  if(options.stats == true || options.shmName != NULL || options.daemonSocket != NULL){
+    return selectStrategy<lockPolicy, queuePolicy, counterStats>(options);
+  }
+  return selectStrategy<lockPolicy, queuePolicy, noStats>(options);
+}
+
+template <class lockPolicy>
+static EFTWorkerFunc_t selectQueue(const transfOptions_t &options)
+{
+#ifndef ENGINE_DEFAULT_ONLY
+  if(options.queuePolicy == QUEUE_POLLING){
+    return selectStats<lockPolicy, pollingQueue>(options);
+  }
+#endif
+  return selectStats<lockPolicy, blockingQueue>(options);
+}
+
+// Picks the instantiation of the engine matching the options
+EFTWorkerFunc_t selectEFTWorker(const transfOptions_t &options)
+{
+#ifndef ENGINE_DEFAULT_ONLY
+  if(options.lockPolicy == LOCK_SPIN){
+    return selectQueue<spinLocking>(options);
+  }
+#endif
+  return selectQueue<mutexLocking>(options);
+}
@@ -0,0 +1,570 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T13:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: transferEngine.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T13:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __TRANSFER_ENGINE__
+#define __TRANSFER_ENGINE__
+
+
+#include <vector>
+#include <algorithm>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "debugMacros.hpp"
+#include "transfProg.hpp"
+#include "crashRecovery.hpp"
+
+// Number of polls of an empty queue before pollingQueue blocks
+#define   QUEUE_POLL_SPINS        256
+// Checks of an account's turn between two yields of the cpu (--ordered)
+#define   TURN_YIELD_SPINS        64
+
+// Worker entry point picked by selectEFTWorker()
+typedef void (*EFTWorkerFunc_t)(processData_t *data, int64_t NumberOfProcesses, \
+  int64_t batchSize);
+
+// Picks the instantiation of the engine matching the options
+EFTWorkerFunc_t selectEFTWorker(const transfOptions_t &options);
+
+
+// -- Lock policies: how an account is locked --
+// (robust: a lock whose owner died is reported with EOWNERDEAD, so the worker
+// keeps an in-flight record and recovers such accounts; see crashRecovery)
+struct mutexLocking {
+  static const bool robust = true;
+  static inline int64_t lock(bankAccount_t *account) { return account->lock(); }
+  static inline int64_t trylock(bankAccount_t *account) { return account->trylock(); }
+  static inline int64_t unlock(bankAccount_t *account) { return account->unlock(); }
+};
+
+struct spinLocking {
+  static const bool robust = false;
+  static inline int64_t lock(bankAccount_t *account) { return account->spinLock(); }
+  static inline int64_t trylock(bankAccount_t *account) { return account->spinTrylock(); }
+  static inline int64_t unlock(bankAccount_t *account) { return account->spinUnlock(); }
+};
+
+// -- Queue policies: how a worker waits for its next request --
+// (legs gets the other credits of a multi-leg transfer)
+struct blockingQueue {
+  static inline EFTRequest_t pop(workerQueue_t *queue, inflightRecord_t *record, \
+    EFTRequest_t *legs) {
+    return queue->popRequest(record, legs);
+  }
+};
+
+// polls the queue for a while before sleeping on it
+struct pollingQueue {
+  static inline EFTRequest_t pop(workerQueue_t *queue, inflightRecord_t *record, \
+    EFTRequest_t *legs) {
+    EFTRequest_t request;
+    for(int64_t spins = 0; spins < QUEUE_POLL_SPINS; spins++){
+      if(queue->tryPopRequest(&request, record, legs) == true){
+        return request;
+      }
+      sched_yield();
+    }
+    return queue->popRequest(record, legs);
+  }
+};
+
+// -- Lookup policies: how a slot of a request reaches its account --
+struct slotLookup {
+  static inline bankAccount_t* account(bankAccountPool_t *pool, int64_t slot) {
+    return pool->atSlot(slot);
+  }
+};
+
+// -- Order policies: whether the transfers on an account keep their order --
+// (with inputOrder, a transfer waits for its turn on each of its accounts
+// before locking them; see awaitTurn())
+struct anyOrder {
+  static const bool enabled = false;
+};
+
+struct inputOrder {
+  static const bool enabled = true;
+};
+
+// -- Instrumentation policies --
+// (noStats compiles to nothing; counterStats fills processData_t::stats and
+// tracingStats also records the timeline into processData_t::trace)
+struct noStats {
+  static const bool enabled = false;
+  static inline void applied(workerStats_t *, int64_t) {}
+  static inline void contended(workerStats_t *) {}
+  static inline void group(workerStats_t *) {}
+  static inline void turnWait(workerStats_t *) {}
+  static inline void latency(workerStats_t *, const EFTRequest_t &) {}
+  static inline int64_t now() { return 0; }
+  static inline void wait(processData_t *, int64_t, int64_t) {}
+  static inline void span(processData_t *, int64_t, int64_t, int64_t) {}
+  static inline void step(processData_t *, int64_t, int64_t, int64_t) {}
+  static inline void finish(processData_t *) {}
+};
+
+struct counterStats {
+  static const bool enabled = true;
+  static inline void applied(workerStats_t *stats, int64_t transfers) {
+    if(stats->firstCommitNs == 0){
+      stats->firstCommitNs = monotonicNs();
+    }
+    // (released: whoever sees the count also sees the balances it covers)
+    __atomic_store_n(&stats->transfers, stats->transfers + transfers, __ATOMIC_RELEASE);
+  }
+  static inline void contended(workerStats_t *stats) { ++stats->contendedLocks; }
+  static inline void group(workerStats_t *stats) { ++stats->groups; }
+  static inline void turnWait(workerStats_t *stats) { ++stats->turnWaits; }
+  // push-to-apply latency of a request the parser timed, per lane
+  static inline void latency(workerStats_t *stats, const EFTRequest_t &request) {
+    if(request.enqueueNs == 0){
+      return;
+    }
+    int64_t lane = request.lane;
+    int64_t elapsed = monotonicNs() - request.enqueueNs;
+    ++stats->laneRequests[lane];
+    stats->laneLatencyNs[lane] += elapsed;
+    if(elapsed > stats->laneMaxLatencyNs[lane]){
+      stats->laneMaxLatencyNs[lane] = elapsed;
+    }
+  }
+  static inline int64_t now() { return 0; }
+  static inline void wait(processData_t *, int64_t, int64_t) {}
+  static inline void span(processData_t *, int64_t, int64_t, int64_t) {}
+  static inline void step(processData_t *, int64_t, int64_t, int64_t) {}
+  static inline void finish(processData_t *) {}
+};
+
+// (the times are taken with now() before the event and monotonicNs() after)
+struct tracingStats : counterStats {
+  static inline int64_t now() { return monotonicNs(); }
+  // a wait for a request, recorded when long enough to matter
+  static inline void wait(processData_t *data, int64_t kind, int64_t startNs) {
+    traceWait(data->trace, kind, startNs, monotonicNs());
+  }
+  static inline void span(processData_t *data, int64_t kind, int64_t startNs, int64_t count) {
+    traceSpan(data->trace, kind, startNs, monotonicNs(), count);
+  }
+  // transfers applied, folded into runs
+  static inline void step(processData_t *data, int64_t kind, int64_t startNs, int64_t count) {
+    traceStep(data->trace, kind, startNs, monotonicNs(), count);
+  }
+  static inline void finish(processData_t *data) { traceFlush(data->trace); }
+};
+
+
+// -- Engine --
+
+// Locks the account at slot; with instrumentation on, a lock found taken is
+// counted (and its wait traced). A lock left by a dead worker is recovered
+// before it is used.
+template <class lockPolicy, class statsPolicy>
+inline void acquireAccount(bankAccount_t *account, int64_t slot, processData_t *workers, \
+  int64_t NumberOfProcesses, processData_t *workerData)
+{
+  int64_t status = 0;
+  if(statsPolicy::enabled){
+    status = lockPolicy::trylock(account);
+    if(status != 0 && status != EOWNERDEAD){
+      int64_t waitStart = statsPolicy::now();
+      statsPolicy::contended(&workerData->stats);
+      status = lockPolicy::lock(account);
+      statsPolicy::span(workerData, TRACE_LOCK_WAIT, waitStart, 1);
+    }
+  }
+  else {
+    status = lockPolicy::lock(account);
+  }
+  if(lockPolicy::robust && status == EOWNERDEAD){
+    recoverAccount(workers, NumberOfProcesses, slot);
+  }
+}
+
+// Waits until the transfers before a request on the account (its turn,
+// sequence) have been applied (--ordered). Every queue holds its requests
+// in input order, so the earliest request not applied yet is always at the
+// front of its queue with its turn come: someone can always go on.
+template <class statsPolicy>
+inline void awaitTurn(bankAccount_t *account, int64_t sequence, processData_t *workerData)
+{
+  if(sequence < 0 || account->getSequence() == sequence){
+    return;
+  }
+  int64_t waitStart = statsPolicy::now();
+  statsPolicy::turnWait(&workerData->stats);
+  for(int64_t spins = 1; account->getSequence() != sequence; spins++){
+    if(spins % TURN_YIELD_SPINS == 0){
+      sched_yield();
+    }
+  }
+  statsPolicy::wait(workerData, TRACE_TURN_WAIT, waitStart);
+}
+
+// Sequential engine: applies a request (and its legs, which follow it) in
+// the calling process. Nothing runs concurrently with it, so there is no
+// queue and no locking.
+inline void EFTApplySequential(bankAccountPool_t *pool, const EFTRequest_t *request)
+{
+  for(int64_t i = 0; i <= request->legs; i++){
+    bankAccount_t *from = pool->atSlot(request[i].fromSlot);
+    bankAccount_t *to = pool->atSlot(request[i].toSlot);
+    from->setBalance(from->getBalance() - request[i].transferAmount);
+    to->setBalance(to->getBalance() + request[i].transferAmount);
+  }
+}
+
+// Applies a multi-leg transfer: all its accounts are locked at once, in
+// ascending slot order like the two of a plain transfer, and the debit and
+// every credit are applied before any of them is unlocked. (The parser
+// merges the credits to the same account, so the accounts are distinct.)
+// On robust locks the in-flight record saves every balance first, so a
+// crash half way is rolled forward like a plain transfer.
+template <class lockPolicy, class lookupPolicy, class statsPolicy, class orderPolicy>
+inline void EFTApplyMultiLeg(processData_t *workerData, processData_t *workers, \
+  int64_t NumberOfProcesses, const EFTRequest_t &request, const EFTRequest_t *legs, \
+  inflightRecord_t *record, int64_t &transfersStarted)
+{
+  bankAccountPool_t *pool = workerData->accountPool;
+  int64_t slots[MAX_TRANSFER_LEGS + 1];
+  int64_t accounts = 0;
+  slots[accounts++] = request.fromSlot;
+  slots[accounts++] = request.toSlot;
+  for(int64_t i = 0; i < request.legs; i++){
+    slots[accounts++] = legs[i].toSlot;
+  }
+  std::sort(slots, slots + accounts);
+  if(orderPolicy::enabled){
+    awaitTurn<statsPolicy>(lookupPolicy::account(pool, request.fromSlot), request.fromSeq, \
+      workerData);
+    awaitTurn<statsPolicy>(lookupPolicy::account(pool, request.toSlot), request.toSeq, \
+      workerData);
+    for(int64_t i = 0; i < request.legs; i++){
+      awaitTurn<statsPolicy>(lookupPolicy::account(pool, legs[i].toSlot), legs[i].toSeq, \
+        workerData);
+    }
+  }
+
+  // ========== ENTER Critical Section ==========
+  for(int64_t i = 0; i < accounts; i++){
+    acquireAccount<lockPolicy, statsPolicy>(lookupPolicy::account(pool, slots[i]), \
+      slots[i], workers, NumberOfProcesses, workerData);
+  }
+    int64_t applyStart = statsPolicy::now();
+    bankAccount_t *from = lookupPolicy::account(pool, request.fromSlot);
+    bankAccount_t *to = lookupPolicy::account(pool, request.toSlot);
+    int64_t debit = request.transferAmount;
+    for(int64_t i = 0; i < request.legs; i++){
+      debit += legs[i].transferAmount;
+    }
+    if(record != NULL){
+      record->fromBalance = from->getBalance();
+      record->toBalance = to->getBalance();
+      for(int64_t i = 0; i < request.legs; i++){
+        record->legBalances[i] = lookupPolicy::account(pool, legs[i].toSlot)->getBalance();
+      }
+      setInflightState(record, INFLIGHT_APPLYING);
+    }
+    from->setBalance(from->getBalance() - debit);
+    // --inject-crash: die half way, with every account locked
+    if(record != NULL && ++transfersStarted == workerData->injectCrashAt){
+      raise(SIGKILL);
+    }
+    to->setBalance(to->getBalance() + request.transferAmount);
+    for(int64_t i = 0; i < request.legs; i++){
+      bankAccount_t *credit = lookupPolicy::account(pool, legs[i].toSlot);
+      credit->setBalance(credit->getBalance() + legs[i].transferAmount);
+    }
+    if(orderPolicy::enabled){
+      from->setSequence(request.fromSeq + 1);
+      to->setSequence(request.toSeq + 1);
+      for(int64_t i = 0; i < request.legs; i++){
+        lookupPolicy::account(pool, legs[i].toSlot)->setSequence(legs[i].toSeq + 1);
+      }
+    }
+    if(record != NULL){
+      setInflightState(record, INFLIGHT_APPLIED);
+    }
+  for(int64_t i = accounts; i > 0; i--){
+    lockPolicy::unlock(lookupPolicy::account(pool, slots[i-1]));
+  }
+  // ========= EXIT Critical Section =========
+  statsPolicy::step(workerData, TRACE_APPLY, applyStart, 1);
+}
+
+// Transfer worker: one request at a time, its two accounts locked in
+// "restricted order" (ascending slots) to avoid deadlocks. On robust locks,
+// the in-flight record follows the request so that it can be finished if
+// this worker dies. With inputOrder, a request first waits for its turn on
+// its accounts, and the turns are passed on before they are unlocked.
+template <class lockPolicy, class queuePolicy, class lookupPolicy, class statsPolicy, \
+  class orderPolicy = anyOrder>
+void EFTTransferWorker(processData_t *data, int64_t NumberOfProcesses, int64_t)
+{
+  processData_t *workerData = data;
+  processData_t *workers = data - data->processID;
+  workerStats_t *stats = &workerData->stats;
+  inflightRecord_t *record = lockPolicy::robust ? &workerData->inflight : NULL;
+  int64_t transfersStarted = 0;
+  EFTRequest_t requestToProcess;
+  EFTRequest_t legs[MAX_TRANSFER_LEGS - 1];
+  // A request the worker before us popped but didn't apply is ours to apply
+  // first: in input order, the others may be waiting for it (see recoverWorker)
+  bool resume = orderPolicy::enabled && record != NULL && record->state == INFLIGHT_POPPED;
+
+  while(1)
+  {
+    // Read data from worker queue/buffer
+    if(resume == true){
+      resume = false;
+      requestToProcess = record->request;
+      for(int64_t i = 0; i < requestToProcess.legs; i++){
+        legs[i] = record->legs[i];
+      }
+    }
+    else {
+      int64_t waitStart = statsPolicy::now();
+      requestToProcess = queuePolicy::pop(&workerData->EFTRequests, record, legs);
+      statsPolicy::wait(workerData, TRACE_POP_WAIT, waitStart);
+    }
+
+    int64_t fromSlot = requestToProcess.fromSlot;
+    int64_t toSlot = requestToProcess.toSlot;
+    int64_t transferAmount = requestToProcess.transferAmount;
+
+    // Check if we are done
+    if(fromSlot == -1 || toSlot == -1){
+      break;
+    }
+    // A transfer to the same account leaves its balance as is
+    if(fromSlot == toSlot){
+      statsPolicy::applied(stats, 1);
+      statsPolicy::latency(stats, requestToProcess);
+      continue;
+    }
+    if(requestToProcess.legs > 0){
+      EFTApplyMultiLeg<lockPolicy, lookupPolicy, statsPolicy, orderPolicy>(workerData, workers, \
+        NumberOfProcesses, requestToProcess, legs, record, transfersStarted);
+      statsPolicy::applied(stats, 1);
+      statsPolicy::latency(stats, requestToProcess);
+      continue;
+    }
+    bankAccount_t *from = lookupPolicy::account(workerData->accountPool, fromSlot);
+    bankAccount_t *to = lookupPolicy::account(workerData->accountPool, toSlot);
+    bankAccount_t *first = (fromSlot < toSlot) ? from : to;
+    bankAccount_t *second = (fromSlot < toSlot) ? to : from;
+    if(orderPolicy::enabled){
+      awaitTurn<statsPolicy>(from, requestToProcess.fromSeq, workerData);
+      awaitTurn<statsPolicy>(to, requestToProcess.toSeq, workerData);
+    }
+
+    // ========== ENTER Critical Section ==========
+      acquireAccount<lockPolicy, statsPolicy>(first, std::min(fromSlot, toSlot), \
+        workers, NumberOfProcesses, workerData);
+      acquireAccount<lockPolicy, statsPolicy>(second, std::max(fromSlot, toSlot), \
+        workers, NumberOfProcesses, workerData);
+        int64_t applyStart = statsPolicy::now();
+        if(record != NULL){
+          record->fromBalance = from->getBalance();
+          record->toBalance = to->getBalance();
+          setInflightState(record, INFLIGHT_APPLYING);
+        }
+        // -- Update the accounts with new balance
+        from->setBalance(from->getBalance() - transferAmount);
+        // --inject-crash: die half way, with both accounts locked
+        if(record != NULL && ++transfersStarted == workerData->injectCrashAt){
+          raise(SIGKILL);
+        }
+        to->setBalance(to->getBalance() + transferAmount);
+        if(orderPolicy::enabled){
+          from->setSequence(requestToProcess.fromSeq + 1);
+          to->setSequence(requestToProcess.toSeq + 1);
+        }
+        if(record != NULL){
+          setInflightState(record, INFLIGHT_APPLIED);
+        }
+
+      lockPolicy::unlock(second);
+      lockPolicy::unlock(first);
+    // ========= EXIT Critical Section =========
+    statsPolicy::step(workerData, TRACE_APPLY, applyStart, 1);
+    statsPolicy::applied(stats, 1);
+    statsPolicy::latency(stats, requestToProcess);
+  }
+  statsPolicy::finish(workerData);
+  dbg_trace("PROCESS: " << workerData->processID << " - " << getpid() << " EXIT!");
+}
+
+
+// Batching worker: pops a group of requests, locks the union of their
+// accounts once (in ascending slot order, as above) and applies the whole
+// group before unlocking. The group size adapts to contention: it is halved
+// whenever a lock was found taken and grows by one otherwise.
+template <class lockPolicy, class queuePolicy, class lookupPolicy, class statsPolicy>
+void EFTBatchWorker(processData_t *data, int64_t NumberOfProcesses, int64_t maxGroupSize)
+{
+  processData_t *workerData = data;
+  processData_t *workers = data - data->processID;
+  workerStats_t *stats = &workerData->stats;
+  std::vector<EFTRequest_t> group;
+  std::vector<int64_t> slots;
+  EFTRequest_t legs[MAX_TRANSFER_LEGS - 1];
+  int64_t groupSize = maxGroupSize;
+  bool exiting = false;
+
+  group.reserve(maxGroupSize);
+  slots.reserve(2 * maxGroupSize);
+  while(exiting == false)
+  {
+    group.clear();
+    // Wait for the first request, then take what is already queued (a
+    // multi-leg transfer is taken whole, so it is applied atomically too)
+    int64_t requests = 0;
+    int64_t waitStart = statsPolicy::now();
+    EFTRequest_t request = queuePolicy::pop(&workerData->EFTRequests, NULL, legs);
+    statsPolicy::wait(workerData, TRACE_POP_WAIT, waitStart);
+    while(1){
+      if(request.fromSlot == -1 || request.toSlot == -1){
+        exiting = true;
+        break;
+      }
+      group.push_back(request);
+      group.insert(group.end(), legs, legs + request.legs);
+      ++requests;
+      if(requests >= groupSize || \
+         workerData->EFTRequests.tryPopRequest(&request, NULL, legs) == false){
+        break;
+      }
+    }
+    if(group.empty()){
+      break;
+    }
+
+    // Union of the accounts of the group, in lock order
+    slots.clear();
+    for(size_t i = 0; i < group.size(); i++){
+      slots.push_back(group[i].fromSlot);
+      slots.push_back(group[i].toSlot);
+    }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+    // ========== ENTER Critical Section ==========
+    bool contended = false;
+    int64_t lockStart = statsPolicy::now();
+    for(size_t i = 0; i < slots.size(); i++){
+      bankAccount_t *account = lookupPolicy::account(workerData->accountPool, slots[i]);
+      // (EOWNERDEAD: we hold it, and recover it as acquireAccount does)
+      int64_t status = lockPolicy::trylock(account);
+      if(status != 0 && status != EOWNERDEAD){
+        contended = true;
+        statsPolicy::contended(stats);
+        status = lockPolicy::lock(account);
+      }
+      if(lockPolicy::robust && status == EOWNERDEAD){
+        recoverAccount(workers, NumberOfProcesses, slots[i]);
+      }
+    }
+    if(contended == true){
+      statsPolicy::span(workerData, TRACE_LOCK_WAIT, lockStart, slots.size());
+    }
+      int64_t applyStart = statsPolicy::now();
+      for(size_t i = 0; i < group.size(); i++){
+        bankAccount_t *from = lookupPolicy::account(workerData->accountPool, group[i].fromSlot);
+        bankAccount_t *to = lookupPolicy::account(workerData->accountPool, group[i].toSlot);
+        from->setBalance(from->getBalance() - group[i].transferAmount);
+        to->setBalance(to->getBalance() + group[i].transferAmount);
+      }
+    for(size_t i = slots.size(); i > 0; i--){
+      lockPolicy::unlock(lookupPolicy::account(workerData->accountPool, slots[i-1]));
+    }
+    // ========= EXIT Critical Section =========
+    statsPolicy::step(workerData, TRACE_APPLY, applyStart, requests);
+    statsPolicy::applied(stats, requests);
+    statsPolicy::group(stats);
+    for(size_t i = 0; statsPolicy::enabled && i < group.size(); i++){
+      statsPolicy::latency(stats, group[i]);
+    }
+
+    if(contended == true){
+      groupSize = std::max<int64_t>(1, groupSize / 2);
+    }
+    else if(groupSize < maxGroupSize){
+      ++groupSize;
+    }
+  }
+  statsPolicy::finish(workerData);
+  dbg_trace("PROCESS: " << workerData->processID << " - " << getpid() \
+    << " (group size " << groupSize << ") EXIT!");
+}
+
+
+// Reduction worker: the balance deltas are accumulated in a private dense
+// array (indexed by slot) and merged into the shared pool once at exit, so no
+// account is locked or written while the transfers are being processed.
+template <class queuePolicy, class lookupPolicy, class statsPolicy>
+void EFTReduceWorker(processData_t *data, int64_t NumberOfProcesses, int64_t)
+{
+  processData_t *workerData = data;
+  workerStats_t *stats = &workerData->stats;
+  EFTRequest_t requests[MAX_TRANSFER_LEGS];
+  std::vector<int64_t> deltas;
+
+  while(1)
+  {
+    // (the legs of a multi-leg transfer follow it)
+    int64_t waitStart = statsPolicy::now();
+    requests[0] = queuePolicy::pop(&workerData->EFTRequests, NULL, requests + 1);
+    statsPolicy::wait(workerData, TRACE_POP_WAIT, waitStart);
+    const EFTRequest_t &requestToProcess = requests[0];
+
+    // Check if we are done
+    if(requestToProcess.fromSlot == -1 || requestToProcess.toSlot == -1){
+      break;
+    }
+    int64_t applyStart = statsPolicy::now();
+    for(int64_t i = 0; i <= requestToProcess.legs; i++){
+      int64_t fromSlot = requests[i].fromSlot;
+      int64_t toSlot = requests[i].toSlot;
+      // The pool only grows between requests; grow the deltas along with it
+      int64_t highSlot = (fromSlot > toSlot) ? fromSlot : toSlot;
+      if(highSlot >= (int64_t) deltas.size()){
+        deltas.resize(std::max<int64_t>(highSlot + 1, 2 * deltas.size()), 0);
+      }
+      deltas[fromSlot] -= requests[i].transferAmount;
+      deltas[toSlot] += requests[i].transferAmount;
+    }
+    statsPolicy::step(workerData, TRACE_APPLY, applyStart, 1);
+    statsPolicy::applied(stats, 1);
+    statsPolicy::latency(stats, requestToProcess);
+  }
+
+  // Merge: every worker starts on its own partition of the slots and wraps
+  // around, so the workers mostly add into different parts of the pool
+  int64_t slots = deltas.size();
+  int64_t firstSlot = (slots * workerData->processID) / NumberOfProcesses;
+  int64_t mergeStart = statsPolicy::now();
+  for(int64_t i = 0; i < slots; i++){
+    int64_t slot = (firstSlot + i) % slots;
+    if(deltas[slot] != 0){
+      lookupPolicy::account(workerData->accountPool, slot)->addBalance(deltas[slot]);
+    }
+  }
+  statsPolicy::span(workerData, TRACE_MERGE, mergeStart, slots);
+  statsPolicy::finish(workerData);
+  dbg_trace("PROCESS: " << workerData->processID << " - " << getpid() \
+    << " merged " << slots << " slots, EXIT!");
+}
+
+
+#endif
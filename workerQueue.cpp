@@ -10,7 +10,9 @@
 
 
 
+#include <errno.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -25,7 +27,8 @@ using namespace std;
 // ------------------------ Class: workerQueue ------------------------------
 
 // Constructor
-void workerQueue :: init()
+// (capacity is clamped to [1, MAX_WORKER_BUFFERSIZE])
+void workerQueue :: init(int64_t capacity)
 {
   if(this->is_initialized == true){
     return;
@@ -34,12 +37,18 @@ void workerQueue :: init()
 
   this->workerID = -1;
   this->shouldExit = false;
+  this->urgentStreak = 0;
 
-  // Setup buffer
-  this->buffer.in = 0;
-  this->buffer.out = 0;
-  this->buffer.capacity = MAX_WORKER_BUFFERSIZE;
-  memset(this->buffer.items, 0, sizeof(this->buffer.items));
+  // Setup buffers (one per lane)
+  if(capacity < 1 || capacity > MAX_WORKER_BUFFERSIZE){
+    capacity = MAX_WORKER_BUFFERSIZE;
+  }
+  for(int lane = 0; lane < QUEUE_LANES; lane++){
+    this->buffer[lane].in = 0;
+    this->buffer[lane].out = 0;
+    this->buffer[lane].capacity = capacity;
+    memset(this->buffer[lane].items, 0, sizeof(this->buffer[lane].items));
+  }
 
   // Process shared
   bool semStatus = sem_init(&this->items, 1, 0);   // Init "items" sem to 0
@@ -47,11 +56,13 @@ void workerQueue :: init()
     print_output("Sem init failed! Worker ID: " << workerID);
     exit(1);
   }
-  // Init "spaces" sem to size of the buffer
-  semStatus = sem_init(&this->spaces, 1, this->buffer.capacity);
-  if(semStatus != 0){
-    print_output("Sem init failed! Worker ID: " << workerID);
-    exit(1);
+  // Init "spaces" sems to size of the buffer
+  for(int lane = 0; lane < QUEUE_LANES; lane++){
+    semStatus = sem_init(&this->spaces[lane], 1, capacity);
+    if(semStatus != 0){
+      print_output("Sem init failed! Worker ID: " << workerID);
+      exit(1);
+    }
   }
   // Process shared
   bool mutexStatus = sem_init(&this->mutex, 1, 1);     // Init sem to 1
@@ -59,6 +70,11 @@ void workerQueue :: init()
     print_output("Sem init failed! Worker ID: " << workerID);
     exit(1);
   }
+  mutexStatus = sem_init(&this->reserve, 1, 1);
+  if(mutexStatus != 0){
+    print_output("Sem init failed! Worker ID: " << workerID);
+    exit(1);
+  }
 }
 
 // Destructor
@@ -70,9 +86,12 @@ void workerQueue :: destroy()
   this->is_initialized = false;
 
   // Cleanup
+  sem_destroy(&this->reserve);
   sem_destroy(&this->mutex);
   sem_destroy(&this->items);
-  sem_destroy(&this->spaces);
+  for(int lane = 0; lane < QUEUE_LANES; lane++){
+    sem_destroy(&this->spaces[lane]);
+  }
 }
 
 // retrieves workerQueue ID
@@ -85,6 +104,19 @@ void workerQueue :: setWorkerID(int64_t ID){
   this->workerID = ID;
 }
 
+// retrieves the capacity of the worker queue (of each lane)
+int64_t workerQueue :: getCapacity(){
+  return this->buffer[LANE_BULK].capacity;
+}
+
+// retrieves the number of queued requests (a snapshot; it may be stale
+// by the time it is returned)
+int64_t workerQueue :: getDepth(){
+  int value = 0;
+  sem_getvalue(&this->items, &value);
+  return value;
+}
+
 // Requests the worker to terminate
 void workerQueue :: requestToExit()
 {
@@ -100,33 +132,86 @@ void workerQueue :: requestToExit()
   sem_post(&this->mutex);
 }
 
-// Adds a new request at the from the back of the queue
-void workerQueue :: pushRequest(EFTRequest_t *newRequest)
+// Waits on a semaphore, until the deadline if there is one; false if the
+// deadline passed
+static bool waitSemaphore(sem_t *semaphore, const struct timespec *deadline)
 {
-  sem_wait(&this->spaces);              // Indicate we we want to occupy a space
+  while((deadline == NULL ? sem_wait(semaphore) : sem_timedwait(semaphore, deadline)) != 0){
+    if(errno != EINTR){
+      return false;
+    }
+  }
+  return true;
+}
+
+// Adds a new request at the back of its lane, with the legs that follow it
+// at newRequest; with a timeout, gives up (returning false) when no space
+// frees up in time, e.g. because the worker died
+// (several producers may push; the spaces of a request with legs are taken
+// under "reserve", so two of them can't each hold part of the lane while
+// waiting for the rest)
+bool workerQueue :: pushRequest(EFTRequest_t *newRequest, int64_t timeoutMs)
+{
+  int lane = (newRequest->lane == LANE_URGENT) ? LANE_URGENT : LANE_BULK;
+  Buffer_t *buffer = &this->buffer[lane];
+  int64_t items = 1 + newRequest->legs;
+  struct timespec deadline;
+  if(timeoutMs >= 0){
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (timeoutMs % 1000) * 1000000;
+    if(deadline.tv_nsec >= 1000000000){
+      deadline.tv_sec += 1;
+      deadline.tv_nsec -= 1000000000;
+    }
+  }
+  // Indicate we we want to occupy a space (one per item)
+  if(items > 1 && waitSemaphore(&this->reserve, (timeoutMs >= 0) ? &deadline : NULL) == false){
+    return false;
+  }
+  for(int64_t taken = 0; taken < items; taken++){
+    if(waitSemaphore(&this->spaces[lane], (timeoutMs >= 0) ? &deadline : NULL) == false){
+      for(; taken > 0; taken--){
+        sem_post(&this->spaces[lane]);
+      }
+      if(items > 1){
+        sem_post(&this->reserve);
+      }
+      return false;
+    }
+  }
+  if(items > 1){
+    sem_post(&this->reserve);
+  }
 
   // -- CRITICAL Start
-  sem_wait(&this->mutex);
+  if(waitSemaphore(&this->mutex, (timeoutMs >= 0) ? &deadline : NULL) == false){
+    for(int64_t taken = 0; taken < items; taken++){
+      sem_post(&this->spaces[lane]);
+    }
+    return false;
+  }
     // Add new request to the queue
-    memset(&this->buffer.items[this->buffer.in], 0, sizeof(EFTRequest_t));
-    memcpy(&this->buffer.items[this->buffer.in], newRequest, sizeof(EFTRequest_t));
+    for(int64_t i = 0; i < items; i++){
+      memcpy(&buffer->items[(buffer->in + i) % buffer->capacity], &newRequest[i], \
+        sizeof(EFTRequest_t));
+    }
     // Increment buffer index
-    this->buffer.in = (this->buffer.in + 1) % this->buffer.capacity;
+    buffer->in += items;
   sem_post(&this->mutex);
 
   // -- CRITICAL End
   sem_post(&this->items);              // Indicate that the request can be read
+  return true;
 }
 
-// Removes the request from the front of the queue
-EFTRequest_t workerQueue :: popRequest()
+// Takes the request at the front of the queue, and its legs; the caller has
+// already consumed an "items" count for it. With a record, the request is
+// recorded as in flight before it leaves the queue.
+EFTRequest_t workerQueue :: takeRequest(inflightRecord_t *record, EFTRequest_t *legs)
 {
-  EFTRequest_t request = { -1, -1, -1, -1};
+  EFTRequest_t request = { -1, -1, -1, -1, LANE_BULK, 0, 0, -1, -1 };
   int value = -1;
-  // if there are 0 items, then we will be blocked
-  // else we will decrement the current no. of items
-  // to Indicate that we will read it
-  sem_wait(&this->items);
 
   // -- CRITICAL Start
   sem_wait(&this->mutex);
@@ -135,13 +220,97 @@ EFTRequest_t workerQueue :: popRequest()
       sem_post(&this->mutex);
       return request;
     }
+    // Urgent lane first, but a waiting bulk request gets a turn after
+    // URGENT_BURST urgent ones in a row
+    Buffer_t *bulk = &this->buffer[LANE_BULK], *urgent = &this->buffer[LANE_URGENT];
+    int lane = LANE_BULK;
+    if(urgent->in > urgent->out && (bulk->in == bulk->out || \
+       this->urgentStreak < URGENT_BURST)){
+      lane = LANE_URGENT;
+      ++this->urgentStreak;
+    }
+    else {
+      this->urgentStreak = 0;
+    }
+    Buffer_t *buffer = &this->buffer[lane];
     // Copy the request from buffer
-    memcpy(&request, &this->buffer.items[this->buffer.out], sizeof(EFTRequest_t));
-    this->buffer.out = (this->buffer.out + 1) % this->buffer.capacity;
+    memcpy(&request, &buffer->items[buffer->out % buffer->capacity], sizeof(EFTRequest_t));
+    request.lane = lane;
+    for(int64_t i = 0; i < request.legs; i++){
+      memcpy(&legs[i], &buffer->items[(buffer->out + 1 + i) % buffer->capacity], \
+        sizeof(EFTRequest_t));
+    }
+    if(record != NULL){
+      record->lane = lane;
+      record->sequence = buffer->out;
+      record->request = request;
+      for(int64_t i = 0; i < request.legs; i++){
+        record->legs[i] = legs[i];
+      }
+      setInflightState(record, INFLIGHT_POPPED);
+    }
+    buffer->out += 1 + request.legs;
   sem_post(&this->mutex);
   // -- CRITICAL End
 
-  sem_post(&this->spaces);        // Indicate that a space has been emptied after reading
+  // Indicate that the spaces have been emptied after reading
+  for(int64_t i = 0; i <= request.legs; i++){
+    sem_post(&this->spaces[lane]);
+  }
 
   return request;
 }
+
+// Removes the request from the front of the queue
+// (legs must have room for MAX_TRANSFER_LEGS - 1 items if the queue may
+// hold multi-leg transfers)
+EFTRequest_t workerQueue :: popRequest(inflightRecord_t *record, EFTRequest_t *legs)
+{
+  // if there are 0 items, then we will be blocked
+  // else we will decrement the current no. of items
+  // to Indicate that we will read it
+  sem_wait(&this->items);
+
+  return this->takeRequest(record, legs);
+}
+
+// Removes the request from the front of the queue, if there is one;
+// returns false (without blocking) when the queue is empty
+bool workerQueue :: tryPopRequest(EFTRequest_t *request, inflightRecord_t *record, \
+  EFTRequest_t *legs)
+{
+  if(sem_trywait(&this->items) != 0){
+    return false;
+  }
+  *request = this->takeRequest(record, legs);
+  return true;
+}
+
+// Repairs the queue after its worker died, possibly in the middle of a pop:
+// a request it recorded but did not take out is left in the queue (and its
+// record reset), and the semaphores are set up again from the lanes. Nobody
+// may use the queue meanwhile. Returns the number of queued requests.
+int64_t workerQueue :: recover(inflightRecord_t *record)
+{
+  if(record->state == INFLIGHT_POPPED && \
+     this->buffer[record->lane].out == record->sequence){
+    record->state = INFLIGHT_IDLE;
+  }
+  int64_t queued = 0;
+  for(int lane = 0; lane < QUEUE_LANES; lane++){
+    Buffer_t *buffer = &this->buffer[lane];
+    sem_destroy(&this->spaces[lane]);
+    sem_init(&this->spaces[lane], 1, buffer->capacity - (buffer->in - buffer->out));
+    // (a request and its legs are one item)
+    for(int64_t at = buffer->out; at < buffer->in; \
+        at += 1 + buffer->items[at % buffer->capacity].legs){
+      ++queued;
+    }
+  }
+  sem_destroy(&this->items);
+  sem_init(&this->items, 1, queued + (this->shouldExit ? 1 : 0));
+  sem_destroy(&this->mutex);
+  sem_init(&this->mutex, 1, 1);
+  this->urgentStreak = 0;
+  return queued;
+}
@@ -19,50 +19,127 @@
 
 // Maximum size of the worker queue for each worker
 #define   MAX_WORKER_BUFFERSIZE   16
+// Most accounts a multi-leg transfer credits; it takes one queue item per
+// credit, so it must fit in a lane
+#define   MAX_TRANSFER_LEGS       15
+// Urgent requests taken in a row before a waiting bulk request gets its turn
+#define   URGENT_BURST            8
+
+// Lanes of a worker queue; the urgent lane is drained first
+enum queueLane {
+  LANE_BULK = 0,
+  LANE_URGENT = 1,
+  QUEUE_LANES = 2
+};
+
+// What a worker has done with the last request it popped
+enum inflightState {
+  INFLIGHT_IDLE = 0,                        // nothing popped yet
+  INFLIGHT_POPPED = 1,                      // popped; no balance touched yet
+  INFLIGHT_APPLYING = 2,                    // balances being updated
+  INFLIGHT_APPLIED = 3                      // both balances updated
+};
 
 // -- Typedefs --
 typedef struct EFTRequest EFTRequest_t;
 typedef struct EFTRequestsBuffer Buffer_t;
+typedef struct inflightRecord inflightRecord_t;
 typedef struct workerQueue workerQueue_t;
 
 // -- Structures --
 // Item for worker queue
+// (accounts are referred to by their slot in the bankAccountPool)
+// A multi-leg transfer debits fromSlot once for all its credits: its first
+// credit is the request itself and the other ones ("legs") are the items
+// right behind it, with the same fromSlot. The items of a request are pushed
+// and taken together.
+// With --ordered, fromSeq and toSeq are the turn of the request on its
+// accounts: the number of transfers before it in the input on each of them
+// (a leg only has its toSeq). -1 when the order doesn't matter.
 struct EFTRequest {
   int64_t workerID;
-  int64_t fromAccount;
-  int64_t toAccount;
+  int64_t fromSlot;
+  int64_t toSlot;
   int64_t transferAmount;
+  int64_t lane;                             // queueLane (LANE_BULK unless urgent)
+  int64_t enqueueNs;                        // when it was pushed (0: not timed)
+  int64_t legs;                             // items following it (0: a plain transfer)
+  int64_t fromSeq;                          // its turn on fromSlot (-1: any order)
+  int64_t toSeq;                            // its turn on toSlot (-1: any order)
 };
 
 // Buffer to hold many items of EFTRequest_t type
+// (in and out count the requests ever pushed and taken; each side writes
+// only its own, so a process dying in the middle leaves them consistent)
 struct EFTRequestsBuffer {
-  int in;
-  int out;
+  int64_t in;
+  int64_t out;
   int64_t capacity;
   EFTRequest_t items[MAX_WORKER_BUFFERSIZE];
 };
 
+// The last request a worker popped and how far it got with it, kept in
+// shared memory so that it can be finished if the worker dies
+struct inflightRecord {
+  int64_t state;                            // inflightState
+  int64_t lane;                             // lane it was taken from
+  int64_t sequence;                         // its position ("out") in that lane
+  EFTRequest_t request;
+  int64_t fromBalance;                      // balances before the transfer
+  int64_t toBalance;                        // (saved before INFLIGHT_APPLYING)
+  EFTRequest_t legs[MAX_TRANSFER_LEGS - 1]; // the other credits (request.legs of them)
+  int64_t legBalances[MAX_TRANSFER_LEGS - 1]; // and their balances before it
+};
+
+// Sets the state of an in-flight record; the stores before and after it
+// are not moved across it (a worker killed between them leaves them in
+// program order)
+inline void setInflightState(inflightRecord_t *record, int64_t state)
+{
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  __atomic_store_n(&record->state, state, __ATOMIC_RELAXED);
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
 // -- Classes --
 // FIFO queue for each worker
 class workerQueue
 {
 private:
   int64_t workerID;
-  sem_t spaces;                             // Sem to indicate no. of present empty spaces
-  sem_t items;                              // Sem to indicate no. of present items
+  sem_t spaces[QUEUE_LANES];                // Sem to indicate no. of empty spaces per lane
+  sem_t items;                              // Sem to indicate no. of queued requests (all lanes)
   sem_t mutex;                              // mutex to protect the queue access
+  sem_t reserve;                            // held while taking several spaces
   bool shouldExit;                          // flag to indicate termination
-  Buffer_t buffer;                  // worker queue to hold EFT Requests
+  Buffer_t buffer[QUEUE_LANES];     // worker queue to hold EFT Requests, per lane
+  int64_t urgentStreak;                     // urgent requests taken in a row
   bool is_initialized = false;
 
+  EFTRequest_t takeRequest(inflightRecord_t *record, \
+    EFTRequest_t *legs);                    // removes the front request
+                                            // (items already taken)
+
 public:
-  void init();                            // Constructor
+  void init(int64_t capacity = MAX_WORKER_BUFFERSIZE);  // Constructor
   void destroy();                           // Destructor
   int64_t getWorkerID();                    // retrieves the worker ID
   void setWorkerID(int64_t ID);             // sets worker ID
-  void pushRequest(EFTRequest_t *request);  // Adds the item from the the back
-  EFTRequest_t popRequest();                // removes the item from the front
+  int64_t getCapacity();                    // retrieves the queue capacity (per lane)
+  int64_t getDepth();                       // retrieves the number of queued requests
+  bool pushRequest(EFTRequest_t *request, \
+    int64_t timeoutMs = -1);                // Adds the request (and its legs, which
+                                            // follow it) at the back of its lane
+                                            // (false if that timed out)
+  EFTRequest_t popRequest(inflightRecord_t *record = NULL, \
+    EFTRequest_t *legs = NULL);             // removes the request from the front
+                                            // (and records it as in flight); its
+                                            // legs go to legs
+  bool tryPopRequest(EFTRequest_t *request, \
+    inflightRecord_t *record = NULL, \
+    EFTRequest_t *legs = NULL);             // same, but doesn't wait for an item
   void requestToExit();                     // request the worker to terminate
+  int64_t recover(inflightRecord_t *record); // repairs the queue of a dead worker
 };
 
 
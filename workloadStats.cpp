@@ -0,0 +1,130 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T15:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: workloadStats.cpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T15:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "debugMacros.hpp"
+#include "workerQueue.hpp"
+#include "lineParser.hpp"
+#include "workloadStats.hpp"
+
+// Std namespace
+using namespace std;
+
+
+// Reads up to maxTransfers transfers from the input (0: all of them); a
+// multi-leg transfer counts as a transfer per credit, as in eftAnalyze
+int64_t sampleTransfers(const char *fileName, int64_t maxTransfers, \
+  std::vector<transferPair_t> &transfers)
+{
+  FILE *input = fopen(fileName, "r");
+  if(input == NULL){
+    dbg_trace("Failed to open the file: " << fileName);
+    return FAIL;
+  }
+  char line[1024];
+  int64_t fields[2 * MAX_TRANSFER_LEGS + 1];
+  while(fgets(line, sizeof(line), input) != NULL && \
+        (maxTransfers == 0 || (int64_t) transfers.size() < maxTransfers))
+  {
+    if(line[0] != 'T' && line[0] != 'S'){
+      continue;
+    }
+    int64_t parsed = parseLineFields(line, strlen(line), true, fields, 2 * MAX_TRANSFER_LEGS + 1);
+    // "Transfer <from> <to> <amount>" or "Split <from> <to> <amount> ..."
+    int64_t credits = (parsed - 1) / 2;
+    if(parsed < 3 || (line[0] == 'T' && credits != 1) || credits > MAX_TRANSFER_LEGS){
+      continue;
+    }
+    for(int64_t i = 0; i < credits; i++){
+      transferPair_t transfer = { fields[0], fields[1 + 2 * i], fields[2 + 2 * i] };
+      transfers.push_back(transfer);
+    }
+  }
+  fclose(input);
+  return SUCCESS;
+}
+
+// Round robin hands consecutive transfers to different workers, so a window
+// of "workers" consecutive transfers is what runs at the same time. A
+// transfer conflicts when the nearest transfer before or after it on one of
+// its accounts is in its window; those are found in a single pass, and then
+// counted for every worker count from minWorkers to maxWorkers
+static void countConflicts(const std::vector<transferPair_t> &transfers, \
+  int64_t minWorkers, int64_t maxWorkers, std::vector<int64_t> &conflicts)
+{
+  int64_t count = transfers.size();
+  std::vector<int64_t> previous(count, -1), next(count, count);
+  std::unordered_map<int64_t, int64_t> lastSeen;           // account -> transfer
+  lastSeen.reserve(2 * count);
+  for(int64_t i = 0; i < count; i++)
+  {
+    int64_t accounts[2] = { transfers[i].fromAccount, transfers[i].toAccount };
+    for(int k = 0; k < ((accounts[0] == accounts[1]) ? 1 : 2); k++){
+      std::pair<std::unordered_map<int64_t, int64_t>::iterator, bool> seen = \
+        lastSeen.insert(std::make_pair(accounts[k], i));
+      if(seen.second == false){
+        int64_t before = seen.first->second;
+        previous[i] = std::max(previous[i], before);
+        next[before] = std::min(next[before], i);
+        seen.first->second = i;
+      }
+    }
+  }
+
+  conflicts.assign(maxWorkers + 1, 0);
+  for(int64_t i = 0; i < count; i++){
+    for(int64_t workers = minWorkers; workers <= maxWorkers; workers++){
+      int64_t window = i / workers;
+      if((previous[i] >= 0 && previous[i] / workers == window) || \
+         (next[i] < count && next[i] / workers == window)){
+        ++conflicts[workers];
+      }
+    }
+  }
+}
+
+// Fraction of the transfers that conflict with a concurrent one
+double estimateConflictRate(const std::vector<transferPair_t> &transfers, \
+  int64_t workers)
+{
+  if(transfers.empty() || workers < 2){
+    return 0.0;
+  }
+  std::vector<int64_t> conflicts;
+  countConflicts(transfers, workers, workers, conflicts);
+  return (double) conflicts[workers] / transfers.size();
+}
+
+// Largest worker count whose estimated conflict rate is acceptable (the
+// rates of every candidate come from one pass over the transfers)
+int64_t recommendWorkers(const std::vector<transferPair_t> &transfers, \
+  int64_t maxWorkers, double maxConflictRate)
+{
+  if(transfers.empty() || maxWorkers < 2){
+    return std::max<int64_t>(maxWorkers, 1);
+  }
+  std::vector<int64_t> conflicts;
+  countConflicts(transfers, 2, maxWorkers, conflicts);
+  int64_t workers = 1;
+  for(int64_t candidate = 2; candidate <= maxWorkers; candidate++){
+    if((double) conflicts[candidate] / transfers.size() > maxConflictRate){
+      break;
+    }
+    workers = candidate;
+  }
+  return workers;
+}
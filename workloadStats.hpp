@@ -0,0 +1,50 @@
+/**
+* @Author: Izhar Shaikh <izhar>
+* @Date:   2026-10-19T15:00:00-05:00
+* @Email:  izharits@gmail.com
+* @Filename: workloadStats.hpp
+* @Last modified by:   izhar
+* @Last modified time: 2026-10-19T15:00:00-05:00
+* @License: MIT
+*/
+
+
+
+#ifndef __WORKLOAD_STATS__
+#define __WORKLOAD_STATS__
+
+
+#include <vector>
+#include <stdint.h>
+
+// Transfers sampled from the head of the input for the "auto" worker count
+#define   AUTO_SAMPLE_TRANSFERS     65536
+// Highest estimated conflict rate accepted for the "auto" worker count
+#define   AUTO_MAX_CONFLICT_RATE    0.10
+
+// -- Typedefs --
+typedef struct transferPair transferPair_t;
+
+// Accounts of a transfer, as account numbers from the input
+struct transferPair {
+  int64_t fromAccount;
+  int64_t toAccount;
+  int64_t transferAmount;
+};
+
+// Reads up to maxTransfers transfers from the input (0: all of them), a
+// transfer per credit of a multi-leg one
+int64_t sampleTransfers(const char *fileName, int64_t maxTransfers, \
+  std::vector<transferPair_t> &transfers);
+
+// Fraction of the transfers that share an account with another transfer
+// running at the same time, when dispatched round robin to "workers" workers
+double estimateConflictRate(const std::vector<transferPair_t> &transfers, \
+  int64_t workers);
+
+// Largest worker count (up to maxWorkers) whose estimated conflict rate
+// stays within maxConflictRate
+int64_t recommendWorkers(const std::vector<transferPair_t> &transfers, \
+  int64_t maxWorkers, double maxConflictRate);
+
+#endif